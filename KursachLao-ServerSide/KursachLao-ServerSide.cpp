@@ -2,13 +2,18 @@
 #include "RequestHandler.h"
 #include "ModuleRegistry.h"
 #include "FileCache.h"
+#include "FileWatcher.h"
+#include "IoUringReader.h"
 #include "macros.h"
 #include "Session.h"
+#include "Listener.h"
 
 #include "DatabaseModule.h"
+#include "DatabaseExecutor.h"
 #include "ApiProcessor.h"
 #include "DoSProtectionModule.h"
 #include "ServerConfig.h"
+#include "ThreadAffinity.h"
 
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/thread.hpp>
@@ -19,72 +24,57 @@
 #include <memory>
 #include <fstream>
 #include <sstream>
-
-void printConnectionInfo(tcp::socket& socket) {
-    try {
-        tcp::endpoint remote_ep = socket.remote_endpoint();
-        boost::asio::ip::address client_address = remote_ep.address();
-        unsigned short client_port = remote_ep.port();
-
-        std::cout << "Client connected from: "
-            << client_address.to_string()
-            << ":" << client_port << std::endl;
-    }
-    catch (const boost::system::system_error& e) {
-        std::cerr << "Error getting connection info: " << e.what() << std::endl;
-    }
+#include <thread>
+#include <vector>
+
+// Обработчик API выполняется на потоке DatabaseExecutor: корутина ждёт транзакцию,
+// а поток io_context тем временем отдаёт статику и принимает соединения
+template<class Handler>
+Router::AsyncHandler onDatabase(DatabaseExecutor* executor, Handler handler) {
+    return [executor, handler](const sRequest& req, sResponce& res, const RouteParams& params) -> net::awaitable<void> {
+        try {
+            co_await executor->run([&]() { handler(req, res, params); });
+        }
+        catch (const DatabaseExecutor::Busy&) {
+            res.result(http::status::service_unavailable);
+            res.set(http::field::retry_after, "1");
+            res.set(http::field::content_type, "application/json");
+            res.body() = R"({"error":"Database busy"})";
+        }
+    };
 }
 
-void CreateAPIHandlers(RequestHandler* module, ApiProcessor* apiProcessor) {
+void CreateAPIHandlers(RequestHandler* module, ApiProcessor* apiProcessor, DatabaseExecutor* dbExecutor) {
     // Основной эндпоинт для всех данных — как ожидает фронт
-    module->addRouteHandler("/api/all-data", [apiProcessor](const sRequest& req, sResponce& res) {
-        apiProcessor->handleGetAllData(req, res);
-        });
+    module->addAsyncRoute(http::verb::get, "/api/all-data", onDatabase(dbExecutor, [apiProcessor](const sRequest& req, sResponce& res, const RouteParams& params) {
+        apiProcessor->handleGetAllData(req, res, params.query("since"));
+        }));
 
     // Список сотрудников (можно оставить как есть, но лучше сделать отдельный обработчик позже)
-    module->addRouteHandler("/api/employees", [apiProcessor](const sRequest& req, sResponce& res) {
-        if (req.method() == http::verb::post) {
-            apiProcessor->handleAddEmployee(req, res);
-        }
-        else if (req.method() == http::verb::get) {
-            apiProcessor->handleGetAllData(req, res); // временно ок — фронт пока не использует отдельно
-        }
-        else {
-            res.result(http::status::method_not_allowed);
-        }
-        });
-
-    module->addDynamicRouteHandler("/api/employees/\\d+(?:/)?", [apiProcessor](const sRequest& req, sResponce& res) {
-        if (req.method() == http::verb::put) {
-            apiProcessor->handleUpdateEmployee(req, res);
-        }
-        else {
-            res.result(http::status::method_not_allowed);
-        }
-        });
-    module->addDynamicRouteHandler("/api/hours/\\d+(?:/)?", [apiProcessor](const sRequest& req, sResponce& res) {
-        if (req.method() == http::verb::post) {
-            apiProcessor->handleAddHours(req, res);
-        }
-        else {
-            res.result(http::status::method_not_allowed);
-        }
-        });
-    module->addDynamicRouteHandler("/api/employees/\\d+/penalties(?:/)?", [apiProcessor](const sRequest& req, sResponce& res) {
-        if (req.method() == http::verb::post) {
-            apiProcessor->handleAddPenalty(req, res);
-        }
-        else {
-            res.result(http::status::method_not_allowed);
-        }
-        });
-    module->addDynamicRouteHandler("/api/employees/\\d+/bonuses(?:/)?", [apiProcessor](const sRequest& req, sResponce& res) {
-        if (req.method() == http::verb::post) {
-            apiProcessor->handleAddBonus(req, res);
-        }
-        else {
-            res.result(http::status::method_not_allowed);
-        }
+    module->addAsyncRoute(http::verb::get, "/api/employees", onDatabase(dbExecutor, [apiProcessor](const sRequest& req, sResponce& res, const RouteParams& params) {
+        apiProcessor->handleGetAllData(req, res, params.query("since")); // временно ок — фронт пока не использует отдельно
+        }));
+    module->addAsyncRoute(http::verb::post, "/api/employees", onDatabase(dbExecutor, [apiProcessor](const sRequest& req, sResponce& res, const RouteParams&) {
+        apiProcessor->handleAddEmployee(req, res);
+        }));
+
+    // Остальным методам на этих путях маршрутизатор сам отвечает 405 с заголовком Allow
+    module->addAsyncRoute(http::verb::put, "/api/employees/{id:int}", onDatabase(dbExecutor, [apiProcessor](const sRequest& req, sResponce& res, const RouteParams& params) {
+        apiProcessor->handleUpdateEmployee(req, res, *params.get_int("id"));
+        }));
+    module->addAsyncRoute(http::verb::post, "/api/hours/{id:int}", onDatabase(dbExecutor, [apiProcessor](const sRequest& req, sResponce& res, const RouteParams& params) {
+        apiProcessor->handleAddHours(req, res, *params.get_int("id"));
+        }));
+    module->addAsyncRoute(http::verb::post, "/api/employees/{id:int}/penalties", onDatabase(dbExecutor, [apiProcessor](const sRequest& req, sResponce& res, const RouteParams& params) {
+        apiProcessor->handleAddPenalty(req, res, *params.get_int("id"));
+        }));
+    module->addAsyncRoute(http::verb::post, "/api/employees/{id:int}/bonuses", onDatabase(dbExecutor, [apiProcessor](const sRequest& req, sResponce& res, const RouteParams& params) {
+        apiProcessor->handleAddBonus(req, res, *params.get_int("id"));
+        }));
+
+    // Метрики очереди базы отдаются с потока io_context, даже когда база не отвечает
+    module->addRoute(http::verb::get, "/api/db-stats", [apiProcessor](const sRequest& req, sResponce& res, const RouteParams&) {
+        apiProcessor->handleDatabaseStats(req, res);
         });
 }
 
@@ -120,19 +110,52 @@ int main(int argc, char* argv[]) {
     //    << " Port: " << port << "\n"
     //    << " Directory: " << directory << "\n\n";
 //////////////////////////////////////////////////////////
-    net::io_context ioc;
+    // В режиме шардов у каждого ядра свой однопоточный io_context, иначе — один общий на весь пул
+    const bool sharded = config.shards > 0;
+    std::vector<std::unique_ptr<net::io_context>> contexts;
+    if (sharded) {
+        for (int i = 0; i < config.shards; ++i) {
+            contexts.push_back(std::make_unique<net::io_context>(1));
+        }
+    }
+    else {
+        contexts.push_back(std::make_unique<net::io_context>(config.threads));  // Подсказка о числе потоков для планировщика asio
+    }
+    net::io_context& ioc = *contexts.front();
 
     const char* databaseStr = "dbname=postgres user=postgres password=postgres host=127.0.0.1 port=54855";//TODO: Перенести хардкод в параметры
 
     ModuleRegistry registry;
-    auto* cacheModule = registry.registerModule<FileCache>(config.directory.c_str(), true, 100);
+    auto* cacheModule = registry.registerModule<FileCache>(config.directory.c_str(), true, config.cache_size, config.cache_max_file,
+        FileCache::Mode::None, config.embedded ? FileCache::Source::Embedded : FileCache::Source::Disk);
+    cacheModule->set_stream_threshold(config.sendfile_threshold);
+    cacheModule->set_mmap_threshold(config.mmap_threshold);
+    cacheModule->set_compression_enabled(config.compress);
+    cacheModule->set_fingerprint_assets(config.fingerprint);
+    FileCache::WarmupOptions warmup;
+    warmup.enabled = config.warmup;
+    warmup.pattern = config.warmup_pattern;
+    warmup.threads = static_cast<unsigned>(config.threads);
+    warmup.background = config.warmup_background;
+    cacheModule->set_warmup(warmup);
+    if (config.io_uring && !config.embedded) {  // Вшитая статика диск не читает
+        cacheModule->set_io_reader(registry.registerModule<IoUringReader>());
+    }
+    if (config.watch && !config.embedded) {  // Вшитая статика не меняется
+        registry.registerModule<FileWatcher>(cacheModule);
+    }
     auto* requestModule = registry.registerModule<RequestHandler>();
     auto* dosProtectionModule = registry.registerModule<DoSProtectionModule>();
-    auto* dbModule = registry.registerModule<DatabaseModule>(ioc, databaseStr);
+    ConnectionPool::Options poolOptions;
+    poolOptions.min_size = config.db_pool_min;
+    poolOptions.max_size = config.db_pool_max;
+    poolOptions.acquire_timeout = std::chrono::milliseconds(config.db_acquire_timeout);
+    auto* dbModule = registry.registerModule<DatabaseModule>(databaseStr, poolOptions, &ApiProcessor::prepareStatements);
+    auto* dbExecutor = registry.registerModule<DatabaseExecutor>(static_cast<unsigned>(config.db_threads), config.db_queue);
 
-    ApiProcessor apiProcessor(dbModule); //TODO: Не совсем подходит моей идеологии управления жизнью через реестр модулей. Однако это по сути обёртка
+    ApiProcessor apiProcessor(dbModule, dbExecutor); //TODO: Не совсем подходит моей идеологии управления жизнью через реестр модулей. Однако это по сути обёртка
 
-    CreateAPIHandlers(requestModule, &apiProcessor);
+    CreateAPIHandlers(requestModule, &apiProcessor, dbExecutor);
 
     CreateNewHandlers(requestModule, config.directory);
 
@@ -146,33 +169,50 @@ int main(int argc, char* argv[]) {
     try {
         auto const net_address = net::ip::make_address(config.address);
         auto const net_port = static_cast<unsigned short>(config.port);
-        tcp::acceptor acceptor{ ioc, {net_address, net_port} };
-        std::cout << "Server started on http://" << config.address << ":" << config.port << std::endl;
-
-        // UPDATED: Do_accept с std::function для safe recursive (avoid self-ref UB)
-        std::function<void()> do_accept_func = [&acceptor, &ioc, requestModule, &do_accept_func, &dosProtectionModule]() {  // NEW: Explicit function, self-capture by ref
-            auto socket = std::make_shared<tcp::socket>(ioc);
-            acceptor.async_accept(*socket,
-                [socket_ptr = socket, &do_accept_func, requestModule, &dosProtectionModule](beast::error_code ec) {
-                    if (!ec) {
-                        printConnectionInfo(*socket_ptr);
-                        std::string ip = (*socket_ptr).remote_endpoint().address().to_string();
-                        if (dosProtectionModule->isAllowed(ip)) {
-                            std::make_shared<session>(std::move(*socket_ptr), requestModule)->run();
-                        }
-                        else {
-                            std::cout << "[" << ip << "] Connection terminated: DoS protection triggered (rate limit exceeded)\n";
-                        }
-                    }
-                    else {
-                        std::cerr << "Accept error: " << ec.message() << std::endl;
-                    }
-                    do_accept_func();  // Рекурсия via function call (safe)
-                });
-            };
-
-        do_accept_func();
-        ioc.run();  // Блокирует, обрабатывает все async
+        const tcp::endpoint endpoint{ net_address, net_port };
+
+        listener::Options options;
+        options.log_connections = config.log_connections;
+        options.session_options.idle_timeout = std::chrono::seconds(config.idle_timeout);
+        options.session_options.header_timeout = std::chrono::seconds(config.header_timeout);
+        options.session_options.body_timeout = std::chrono::seconds(config.body_timeout);
+        options.session_options.write_timeout = std::chrono::seconds(config.write_timeout);
+        options.session_options.max_requests = config.max_keepalive_requests;
+
+        std::vector<std::thread> workers;
+        if (sharded) {
+            // Шард на ядро: ядро само раскидывает соединения по акцепторам (SO_REUSEPORT),
+            // сессия живёт и обрабатывается на том же ядре, где была принята
+            options.reuse_port = true;
+            options.strand_per_session = false;
+            for (auto& ctx : contexts) {
+                std::make_shared<listener>(*ctx, endpoint, requestModule, dosProtectionModule, options)->run();
+            }
+            std::cout << "Server started on http://" << config.address << ":" << config.port
+                << " (" << config.shards << " shards)" << std::endl;
+
+            workers.reserve(contexts.size());
+            for (std::size_t i = 0; i < contexts.size(); ++i) {
+                workers.emplace_back([ctx = contexts[i].get(), i]() {
+                    pinCurrentThreadToCore(static_cast<unsigned int>(i));
+                    ctx->run();
+                    });
+            }
+        }
+        else {
+            std::make_shared<listener>(ioc, endpoint, requestModule, dosProtectionModule, options)->run();
+            std::cout << "Server started on http://" << config.address << ":" << config.port << std::endl;
+
+            // Пул воркеров: текущий поток тоже крутит io_context, поэтому создаём threads - 1 дополнительных
+            workers.reserve(config.threads - 1);
+            for (int i = 1; i < config.threads; ++i) {
+                workers.emplace_back([&ioc]() { ioc.run(); });
+            }
+            ioc.run();  // Блокирует, обрабатывает все async
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
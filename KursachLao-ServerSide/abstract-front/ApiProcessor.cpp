@@ -1,24 +1,85 @@
 ﻿#include "ApiProcessor.h"
 #include "DatabaseModule.h"
+#include "DatabaseExecutor.h"
 
-#include <boost/algorithm/string.hpp>
 #include <boost/json.hpp>
 #include <pqxx/pqxx>
 
 #include <sstream>
 #include <iostream>
-#include <regex>
 
 namespace bj = boost::json;
 namespace http = boost::beast::http;
 
-ApiProcessor::ApiProcessor(DatabaseModule* db_module) : db_module_(db_module) {}
+namespace {
+    struct Statement {
+        const char* name;
+        const char* sql;
+    };
+
+    // Все запросы ApiProcessor. Готовятся один раз на каждом соединении пула (prepareStatements),
+    // в обработчиках выполняются по имени — Postgres не разбирает и не планирует их заново.
+    // Необязательные параметры — NULL: фильтр since и частичное обновление сотрудника
+    // обходятся одним запросом вместо строки SQL на каждую комбинацию
+    constexpr Statement statements[] = {
+        { "dashboard",
+            "SELECT "
+            "COALESCE(SUM(penalties_count), 0) AS penalties, "
+            "COALESCE(SUM(bonuses_count), 0) AS bonuses, "
+            "COALESCE(SUM(wh.undertime), 0) AS undertime "
+            "FROM employees e "
+            "LEFT JOIN work_hours wh ON e.id = wh.employee_id "
+            "WHERE e.status = 'hired'" },
+        { "employees_since", "SELECT * FROM employees WHERE $1::timestamp IS NULL OR updated_at > $1::timestamp" },
+        { "hours_since", "SELECT * FROM work_hours WHERE $1::timestamp IS NULL OR updated_at > $1::timestamp" },
+        // У штрафов и премий нет updated_at — записи не меняются после создания
+        { "penalties_since", "SELECT * FROM penalties WHERE $1::timestamp IS NULL OR created_at > $1::timestamp" },
+        { "bonuses_since", "SELECT * FROM bonuses WHERE $1::timestamp IS NULL OR created_at > $1::timestamp" },
+        { "last_updated", R"(
+            SELECT GREATEST(
+                COALESCE((SELECT MAX(updated_at) FROM employees),  '1970-01-01'::timestamp),
+                COALESCE((SELECT MAX(updated_at) FROM work_hours),  '1970-01-01'::timestamp),
+                COALESCE((SELECT MAX(created_at) FROM penalties), '1970-01-01'::timestamp),
+                COALESCE((SELECT MAX(created_at) FROM bonuses),   '1970-01-01'::timestamp)
+            ) AS ts
+        )" },
+        { "insert_employee", "INSERT INTO employees (fullname, status, salary) VALUES ($1, $2, $3) RETURNING *" },
+        { "insert_employee_hours", "INSERT INTO work_hours (employee_id) VALUES ($1)" },
+        { "update_employee",
+            "UPDATE employees SET "
+            "fullname = COALESCE($2::text, fullname), "
+            "status = COALESCE($3::text, status), "
+            "salary = COALESCE($4::numeric, salary), "
+            "updated_at = CURRENT_TIMESTAMP "
+            "WHERE id = $1 RETURNING *" },
+        { "upsert_hours",
+            "INSERT INTO work_hours (employee_id, regular_hours, overtime, undertime) "
+            "VALUES ($1, $2, $3, $4) "
+            "ON CONFLICT (employee_id) DO UPDATE SET "
+            "regular_hours = EXCLUDED.regular_hours, "
+            "overtime = EXCLUDED.overtime, "
+            "undertime = EXCLUDED.undertime "
+            "RETURNING *" },
+        { "hired_employee", "SELECT 1 FROM employees WHERE id = $1 AND status = 'hired'" },
+        { "insert_penalty", "INSERT INTO penalties (employee_id, reason, amount) VALUES ($1, $2, $3) RETURNING *" },
+        { "insert_bonus", "INSERT INTO bonuses (employee_id, note, amount) VALUES ($1, $2, $3) RETURNING *" },
+    };
+}
+
+void ApiProcessor::prepareStatements(pqxx::connection& conn) {
+    for (const auto& statement : statements) {
+        conn.prepare(statement.name, statement.sql);
+    }
+}
+
+ApiProcessor::ApiProcessor(DatabaseModule* db_module, DatabaseExecutor* db_executor)
+    : db_module_(db_module), db_executor_(db_executor) {}
 
-pqxx::connection* ApiProcessor::getConn() {
-    if (!db_module_ || !db_module_->isDatabaseReady()) {
-        return nullptr;
+ConnectionPool::Lease ApiProcessor::getConn() {
+    if (!db_module_) {
+        return {};
     }
-    return db_module_->getConnection();
+    return db_module_->acquireConnection();
 }
 
 void ApiProcessor::sendJsonError(http::response<http::string_body>& res,
@@ -74,94 +135,46 @@ bj::object ApiProcessor::bonusToJson(const pqxx::row& row) {
     return obj;
 }
 
-std::optional<std::string> ApiProcessor::getQueryParam(const std::string& target,
-    const std::string& param_name) {
-    size_t pos = target.find('?');
-    if (pos == std::string::npos) return std::nullopt;
-
-    std::string query = target.substr(pos + 1);
-    std::vector<std::string> pairs;
-    boost::split(pairs, query, boost::is_any_of("&"));
-
-    for (const auto& pair : pairs) {
-        std::vector<std::string> kv;
-        boost::split(kv, pair, boost::is_any_of("="));
-        if (kv.size() == 2 && kv[0] == param_name) {
-            return kv[1];
-        }
-    }
-    return std::nullopt;
-}
-
-std::optional<int> ApiProcessor::parseIdFromPath(const std::string& path,
-    const std::string& prefix) {
-    std::regex re(prefix + "(\\d+)");
-    std::smatch match;
-    if (std::regex_search(path, match, re) && match.size() > 1) {
-        return std::stoi(match.str(1));
-    }
-    return std::nullopt;
-}
-
 void ApiProcessor::handleGetAllData(const http::request<http::string_body>& req,
-    http::response<http::string_body>& res) {
-    auto* conn = getConn();
+    http::response<http::string_body>& res, std::optional<std::string_view> since) {
+    auto conn = getConn();
     if (!conn) {
         return sendJsonError(res, http::status::service_unavailable, "Database not ready");
     }
 
-    if (req.method() != http::verb::get) {
-        return sendJsonError(res, http::status::method_not_allowed, "Only GET allowed");
-    }
-
-    std::string target_str = std::string(req.target());
-    auto since_opt = getQueryParam(target_str, "since");
-    std::string since_clause;
-    if (since_opt) {
-        since_clause = " WHERE updated_at > " + conn->quote(*since_opt);
+    // NULL — без фильтра
+    std::optional<std::string> since_param;
+    if (since) {
+        since_param = std::string(*since);
     }
 
     try {
         pqxx::work txn(*conn);
 
         bj::object dashboard;
-        auto agg = txn.exec(
-            "SELECT "
-            "COALESCE(SUM(penalties_count), 0) AS penalties, "
-            "COALESCE(SUM(bonuses_count), 0) AS bonuses, "
-            "COALESCE(SUM(wh.undertime), 0) AS undertime "
-            "FROM employees e "
-            "LEFT JOIN work_hours wh ON e.id = wh.employee_id "
-            "WHERE e.status = 'hired'");
+        auto agg = txn.exec(pqxx::prepped{ "dashboard" });
 
         dashboard["penalties"] = agg[0]["penalties"].as<int64_t>();
         dashboard["bonuses"] = agg[0]["bonuses"].as<int64_t>();
         dashboard["undertime"] = agg[0]["undertime"].as<double>();
 
         bj::array employees_arr;
-        auto emp_res = txn.exec(pqxx::zview("SELECT * FROM employees" + since_clause));
+        auto emp_res = txn.exec(pqxx::prepped{ "employees_since" }, pqxx::params{ since_param });
         for (const auto& row : emp_res) employees_arr.emplace_back(employeeToJson(row));
 
         bj::array hours_arr;
-        auto hours_res = txn.exec(pqxx::zview("SELECT * FROM work_hours" + since_clause));
+        auto hours_res = txn.exec(pqxx::prepped{ "hours_since" }, pqxx::params{ since_param });
         for (const auto& row : hours_res) hours_arr.emplace_back(hoursToJson(row));
 
         bj::array penalties_arr;
-        auto pen_res = txn.exec(pqxx::zview("SELECT * FROM penalties" + since_clause));
+        auto pen_res = txn.exec(pqxx::prepped{ "penalties_since" }, pqxx::params{ since_param });
         for (const auto& row : pen_res) penalties_arr.emplace_back(penaltyToJson(row));
 
         bj::array bonuses_arr;
-        auto bon_res = txn.exec(pqxx::zview("SELECT * FROM bonuses" + since_clause));
+        auto bon_res = txn.exec(pqxx::prepped{ "bonuses_since" }, pqxx::params{ since_param });
         for (const auto& row : bon_res) bonuses_arr.emplace_back(bonusToJson(row));
 
-        auto last_res = txn.exec(pqxx::zview(R"(
-            SELECT GREATEST(
-                COALESCE((SELECT MAX(updated_at) FROM employees),  '1970-01-01'::timestamp),
-                COALESCE((SELECT MAX(updated_at) FROM work_hours),  '1970-01-01'::timestamp),
-                COALESCE((SELECT MAX(created_at) FROM penalties), '1970-01-01'::timestamp),
-                COALESCE((SELECT MAX(created_at) FROM bonuses),   '1970-01-01'::timestamp)
-            ) AS ts
-        )"));
+        auto last_res = txn.exec(pqxx::prepped{ "last_updated" });
 
         std::string last_updated = last_res[0]["ts"].as<std::string>();
 
@@ -178,6 +191,10 @@ void ApiProcessor::handleGetAllData(const http::request<http::string_body>& req,
         res.body() = bj::serialize(response);
         res.prepare_payload();
     }
+    catch (const pqxx::broken_connection& e) {
+        conn.invalidate();  // Разорванное соединение в пул не вернётся
+        sendJsonError(res, http::status::service_unavailable, e.what());
+    }
     catch (const std::exception& e) {
         sendJsonError(res, http::status::internal_server_error, e.what());
     }
@@ -185,13 +202,9 @@ void ApiProcessor::handleGetAllData(const http::request<http::string_body>& req,
 
 void ApiProcessor::handleAddEmployee(const http::request<http::string_body>& req,
     http::response<http::string_body>& res) {
-    auto* conn = getConn();
+    auto conn = getConn();
     if (!conn) return sendJsonError(res, http::status::service_unavailable, "Database not ready");
 
-    if (req.method() != http::verb::post) {
-        return sendJsonError(res, http::status::method_not_allowed, "Only POST allowed");
-    }
-
     //std::cout << "Received request target: " << req.target() << std::endl;
     //std::cout << "Received body: |" << req.body() << "|" << std::endl;
 
@@ -226,14 +239,11 @@ void ApiProcessor::handleAddEmployee(const http::request<http::string_body>& req
 
         pqxx::work txn(*conn);
 
-        auto r = txn.exec(pqxx::zview(
-            "INSERT INTO employees (fullname, status, salary) VALUES ($1, $2, $3) RETURNING *"),
-            pqxx::params{ fullname, status, salary });
+        auto r = txn.exec(pqxx::prepped{ "insert_employee" }, pqxx::params{ fullname, status, salary });
 
         int new_id = r[0]["id"].as<int>();
 
-        txn.exec(pqxx::zview("INSERT INTO work_hours (employee_id) VALUES ($1)"),
-            pqxx::params{ new_id });
+        txn.exec(pqxx::prepped{ "insert_employee_hours" }, pqxx::params{ new_id });
 
         txn.commit();
 
@@ -246,45 +256,40 @@ void ApiProcessor::handleAddEmployee(const http::request<http::string_body>& req
         std::cout << "Parse error: " << se.what() << std::endl; //FIXME: Будет срать ошибками boost в фронт
         sendJsonError(res, http::status::bad_request, "Invalid JSON");
     }
+    catch (const pqxx::broken_connection& e) {
+        conn.invalidate();  // Разорванное соединение в пул не вернётся
+        sendJsonError(res, http::status::service_unavailable, e.what());
+    }
     catch (const std::exception& e) {
         sendJsonError(res, http::status::bad_request, e.what());
     }
 }
 
 void ApiProcessor::handleUpdateEmployee(const http::request<http::string_body>& req,
-    http::response<http::string_body>& res) {
-    auto* conn = getConn();
+    http::response<http::string_body>& res, int id) {
+    auto conn = getConn();
     if (!conn) return sendJsonError(res, http::status::service_unavailable, "Database not ready");
 
-    if (req.method() != http::verb::put) {
-        return sendJsonError(res, http::status::method_not_allowed, "Only PUT allowed");
-    }
-
-    std::string target_str = std::string(req.target());
-    auto id_opt = parseIdFromPath(target_str, "/api/employees/");
-    if (!id_opt) return sendJsonError(res, http::status::bad_request, "Invalid employee ID");
-    int id = *id_opt;
-
     try {
         bj::value jv = bj::parse(req.body());
         const bj::object& body = jv.as_object();
 
-        std::string set_clause;
-        pqxx::params update_params;
+        // Не пришедшее поле остаётся NULL, и update_employee оставляет столбец как есть (COALESCE)
+        std::optional<std::string> fullname;
+        std::optional<std::string> status;
+        std::optional<double> salary;
 
         if (body.contains("fullname")) {
             std::string fn = std::string(body.at("fullname").as_string());
             if (fn.size() < 3) return sendJsonError(res, http::status::bad_request, "Fullname too short");
-            set_clause += "fullname = $" + std::to_string(update_params.size() + 1) + ", ";
-            update_params.append(fn);
+            fullname = std::move(fn);
         }
         if (body.contains("status")) {
             std::string st = std::string(body.at("status").as_string());
             if (st != "hired" && st != "fired" && st != "interview") {
                 return sendJsonError(res, http::status::bad_request, "Invalid status");
             }
-            set_clause += "status = $" + std::to_string(update_params.size() + 1) + ", ";
-            update_params.append(st);
+            status = std::move(st);
         }
         if (body.contains("salary")) {
             double sal = 0.0;
@@ -295,22 +300,15 @@ void ApiProcessor::handleUpdateEmployee(const http::request<http::string_body>&
                 sal = body.at("salary").as_double();
             }
             if (sal <= 0) return sendJsonError(res, http::status::bad_request, "Salary must be > 0");
-            set_clause += "salary = $" + std::to_string(update_params.size() + 1) + ", ";
-            update_params.append(sal);
+            salary = sal;
         }
 
-        if (set_clause.empty()) {
+        if (!fullname && !status && !salary) {
             return sendJsonError(res, http::status::bad_request, "No fields to update");
         }
 
-        set_clause += "updated_at = CURRENT_TIMESTAMP";
-        update_params.append(id); // последний параметр — id
-
         pqxx::work txn(*conn);
-        std::string query = "UPDATE employees SET " + set_clause +
-            " WHERE id = $" + std::to_string(update_params.size()) + " RETURNING *";
-
-        auto r = txn.exec(pqxx::zview(query), update_params);
+        auto r = txn.exec(pqxx::prepped{ "update_employee" }, pqxx::params{ id, fullname, status, salary });
 
         if (r.empty()) {
             return sendJsonError(res, http::status::not_found, "Employee not found");
@@ -326,25 +324,20 @@ void ApiProcessor::handleUpdateEmployee(const http::request<http::string_body>&
     catch (const boost::system::system_error&) {
         sendJsonError(res, http::status::bad_request, "Invalid JSON");
     }
+    catch (const pqxx::broken_connection& e) {
+        conn.invalidate();  // Разорванное соединение в пул не вернётся
+        sendJsonError(res, http::status::service_unavailable, e.what());
+    }
     catch (const std::exception& e) {
         sendJsonError(res, http::status::internal_server_error, e.what());
     }
 }
 
 void ApiProcessor::handleAddHours(const http::request<http::string_body>& req,
-    http::response<http::string_body>& res) {
-    auto* conn = getConn();
+    http::response<http::string_body>& res, int employee_id) {
+    auto conn = getConn();
     if (!conn) return sendJsonError(res, http::status::service_unavailable, "Database not ready");
 
-    if (req.method() != http::verb::post) {
-        return sendJsonError(res, http::status::method_not_allowed, "Only POST allowed");
-    }
-
-    std::string target_str = std::string(req.target());
-    auto id_opt = parseIdFromPath(target_str, "/api/hours/");
-    if (!id_opt) return sendJsonError(res, http::status::bad_request, "Invalid employee ID");
-    int employee_id = *id_opt;
-
     try {
         bj::value jv = bj::parse(req.body());
         const bj::object& body = jv.as_object();
@@ -383,15 +376,7 @@ void ApiProcessor::handleAddHours(const http::request<http::string_body>& req,
 
         pqxx::work txn(*conn);
 
-        auto r = txn.exec(pqxx::zview(
-            "INSERT INTO work_hours (employee_id, regular_hours, overtime, undertime) "
-            "VALUES ($1, $2, $3, $4) "
-            "ON CONFLICT (employee_id) DO UPDATE SET "
-            "regular_hours = EXCLUDED.regular_hours, "
-            "overtime = EXCLUDED.overtime, "
-            "undertime = EXCLUDED.undertime "
-            "RETURNING *"),
-            pqxx::params{ employee_id, regular, overtime, undertime });
+        auto r = txn.exec(pqxx::prepped{ "upsert_hours" }, pqxx::params{ employee_id, regular, overtime, undertime });
 
         txn.commit();
 
@@ -404,25 +389,20 @@ void ApiProcessor::handleAddHours(const http::request<http::string_body>& req,
         std::cout << "ApiProcessor Error: " << se.what();
         sendJsonError(res, http::status::bad_request, "Invalid JSON");
     }
+    catch (const pqxx::broken_connection& e) {
+        conn.invalidate();  // Разорванное соединение в пул не вернётся
+        sendJsonError(res, http::status::service_unavailable, e.what());
+    }
     catch (const std::exception& e) {
         sendJsonError(res, http::status::internal_server_error, e.what());
     }
 }
 
 void ApiProcessor::handleAddPenalty(const http::request<http::string_body>& req,
-    http::response<http::string_body>& res) {
-    auto* conn = getConn();
+    http::response<http::string_body>& res, int employee_id) {
+    auto conn = getConn();
     if (!conn) return sendJsonError(res, http::status::service_unavailable, "Database not ready");
 
-    if (req.method() != http::verb::post) {
-        return sendJsonError(res, http::status::method_not_allowed, "Only POST allowed");
-    }
-
-    std::string target_str = std::string(req.target());
-    auto id_opt = parseIdFromPath(target_str, "/api/employees/");
-    if (!id_opt) return sendJsonError(res, http::status::bad_request, "Invalid employee ID");
-    int employee_id = *id_opt;
-
     try {
         bj::value jv = bj::parse(req.body());
         const bj::object& body = jv.as_object();
@@ -441,13 +421,10 @@ void ApiProcessor::handleAddPenalty(const http::request<http::string_body>& req,
 
         pqxx::work txn(*conn);
 
-        auto check = txn.exec(pqxx::zview("SELECT 1 FROM employees WHERE id = $1 AND status = 'hired'"),
-            pqxx::params{ employee_id });
+        auto check = txn.exec(pqxx::prepped{ "hired_employee" }, pqxx::params{ employee_id });
         if (check.empty()) return sendJsonError(res, http::status::bad_request, "Employee not found or not hired");
 
-        auto r = txn.exec(pqxx::zview(
-            "INSERT INTO penalties (employee_id, reason, amount) VALUES ($1, $2, $3) RETURNING *"),
-            pqxx::params{ employee_id, reason, amount });
+        auto r = txn.exec(pqxx::prepped{ "insert_penalty" }, pqxx::params{ employee_id, reason, amount });
 
         txn.commit();
 
@@ -460,25 +437,20 @@ void ApiProcessor::handleAddPenalty(const http::request<http::string_body>& req,
         std::cout << "ApiProcessor Error:" << se.what();
         sendJsonError(res, http::status::bad_request, "Invalid JSON");
     }
+    catch (const pqxx::broken_connection& e) {
+        conn.invalidate();  // Разорванное соединение в пул не вернётся
+        sendJsonError(res, http::status::service_unavailable, e.what());
+    }
     catch (const std::exception& e) {
         sendJsonError(res, http::status::internal_server_error, e.what());
     }
 }
 
 void ApiProcessor::handleAddBonus(const http::request<http::string_body>& req,
-    http::response<http::string_body>& res) {
-    auto* conn = getConn();
+    http::response<http::string_body>& res, int employee_id) {
+    auto conn = getConn();
     if (!conn) return sendJsonError(res, http::status::service_unavailable, "Database not ready");
 
-    if (req.method() != http::verb::post) {
-        return sendJsonError(res, http::status::method_not_allowed, "Only POST allowed");
-    }
-
-    std::string target_str = std::string(req.target());
-    auto id_opt = parseIdFromPath(target_str, "/api/employees/");
-    if (!id_opt) return sendJsonError(res, http::status::bad_request, "Invalid employee ID");
-    int employee_id = *id_opt;
-
     try {
         bj::value jv = bj::parse(req.body());
         const bj::object& body = jv.as_object();
@@ -497,13 +469,10 @@ void ApiProcessor::handleAddBonus(const http::request<http::string_body>& req,
 
         pqxx::work txn(*conn);
 
-        auto check = txn.exec(pqxx::zview("SELECT 1 FROM employees WHERE id = $1 AND status = 'hired'"),
-            pqxx::params{ employee_id });
+        auto check = txn.exec(pqxx::prepped{ "hired_employee" }, pqxx::params{ employee_id });
         if (check.empty()) return sendJsonError(res, http::status::bad_request, "Employee not found or not hired");
 
-        auto r = txn.exec(pqxx::zview(
-            "INSERT INTO bonuses (employee_id, note, amount) VALUES ($1, $2, $3) RETURNING *"),
-            pqxx::params{ employee_id, note, amount });
+        auto r = txn.exec(pqxx::prepped{ "insert_bonus" }, pqxx::params{ employee_id, note, amount });
 
         txn.commit();
 
@@ -515,7 +484,55 @@ void ApiProcessor::handleAddBonus(const http::request<http::string_body>& req,
     catch (const boost::system::system_error&) {
         sendJsonError(res, http::status::bad_request, "Invalid JSON");
     }
+    catch (const pqxx::broken_connection& e) {
+        conn.invalidate();  // Разорванное соединение в пул не вернётся
+        sendJsonError(res, http::status::service_unavailable, e.what());
+    }
     catch (const std::exception& e) {
         sendJsonError(res, http::status::internal_server_error, e.what());
     }
-}
\ No newline at end of file
+}
+
+void ApiProcessor::handleDatabaseStats(const http::request<http::string_body>& req,
+    http::response<http::string_body>& res) {
+    if (!db_executor_) {
+        return sendJsonError(res, http::status::service_unavailable, "Database executor is not configured");
+    }
+    const auto stats = db_executor_->stats();
+    const auto finished = stats.completed > 0 ? stats.completed : 1;
+
+    bj::object obj;
+    obj["threads"] = stats.threads;
+    obj["queueDepth"] = stats.queue_depth;
+    obj["maxQueueDepth"] = stats.max_queue_depth;
+    obj["queueLimit"] = stats.queue_limit;
+    obj["active"] = stats.active;
+    obj["completed"] = stats.completed;
+    obj["rejected"] = stats.rejected;
+    obj["avgWaitUs"] = stats.total_wait.count() / static_cast<std::int64_t>(finished);
+    obj["maxWaitUs"] = stats.max_wait.count();
+
+    if (db_module_) {
+        const auto pool = db_module_->poolStats();
+        const auto acquired = pool.acquired > 0 ? pool.acquired : 1;
+        bj::object pool_obj;
+        pool_obj["size"] = pool.size;
+        pool_obj["idle"] = pool.idle;
+        pool_obj["inUse"] = pool.in_use;
+        pool_obj["waiting"] = pool.waiting;
+        pool_obj["acquired"] = pool.acquired;
+        pool_obj["timeouts"] = pool.timeouts;
+        pool_obj["connects"] = pool.connects;
+        pool_obj["connectFailures"] = pool.connect_failures;
+        pool_obj["broken"] = pool.broken;
+        pool_obj["avgWaitUs"] = pool.total_wait.count() / static_cast<std::int64_t>(acquired);
+        pool_obj["maxWaitUs"] = pool.max_wait.count();
+        obj["pool"] = std::move(pool_obj);
+    }
+
+    res.result(http::status::ok);
+    res.set(http::field::content_type, "application/json");
+    res.set(http::field::cache_control, "no-cache, must-revalidate");
+    res.body() = bj::serialize(obj);
+    res.prepare_payload();
+}
@@ -3,16 +3,18 @@
 #include <boost/json.hpp>
 #include <pqxx/pqxx>
 #include <string>
+#include <string_view>
 #include <optional>
 #include <vector>
-#include <regex>
 
 #include <boost/system/error_code.hpp>  
 #include <pqxx/params>                  
 
+#include "ConnectionPool.h"
 #include "macros.h"  // Для http::request, http::response и т.д.
 
 class DatabaseModule;
+class DatabaseExecutor;
 
 namespace bj = boost::json;
 namespace http = boost::beast::http;
@@ -20,8 +22,10 @@ namespace http = boost::beast::http;
 class ApiProcessor {
 private:
     DatabaseModule* db_module_;
-
-    pqxx::connection* getConn();
+    DatabaseExecutor* db_executor_;
+    // Соединение из пула на время обработчика: у каждого потока базы своё, без общей блокировки.
+    // Пустая аренда — база не готова или пул исчерпан
+    ConnectionPool::Lease getConn();
 
     void sendJsonError(http::response<http::string_body>& res,
         http::status status,
@@ -32,16 +36,22 @@ private:
     bj::object penaltyToJson(const pqxx::row& row);
     bj::object bonusToJson(const pqxx::row& row);
 
-    std::optional<std::string> getQueryParam(const std::string& target, const std::string& param_name);
-    std::optional<int> parseIdFromPath(const std::string& path, const std::string& prefix);
-
 public:
-    explicit ApiProcessor(DatabaseModule* db_module);
+    ApiProcessor(DatabaseModule* db_module, DatabaseExecutor* db_executor);
 
-    void handleGetAllData(const http::request<http::string_body>& req, http::response<http::string_body>& res);
+    // Подготовленные запросы обработчиков. Передаётся в DatabaseModule как хук нового соединения пула
+    static void prepareStatements(pqxx::connection& conn);
+
+    // Метод и id из пути уже проверены маршрутизатором (см. CreateAPIHandlers).
+    // handle* блокируют поток на время транзакции — вызываются на потоках DatabaseExecutor
+    void handleGetAllData(const http::request<http::string_body>& req, http::response<http::string_body>& res,
+        std::optional<std::string_view> since);
     void handleAddEmployee(const http::request<http::string_body>& req, http::response<http::string_body>& res);
-    void handleUpdateEmployee(const http::request<http::string_body>& req, http::response<http::string_body>& res);
-    void handleAddHours(const http::request<http::string_body>& req, http::response<http::string_body>& res);
-    void handleAddPenalty(const http::request<http::string_body>& req, http::response<http::string_body>& res);
-    void handleAddBonus(const http::request<http::string_body>& req, http::response<http::string_body>& res);
+    void handleUpdateEmployee(const http::request<http::string_body>& req, http::response<http::string_body>& res, int id);
+    void handleAddHours(const http::request<http::string_body>& req, http::response<http::string_body>& res, int employee_id);
+    void handleAddPenalty(const http::request<http::string_body>& req, http::response<http::string_body>& res, int employee_id);
+    void handleAddBonus(const http::request<http::string_body>& req, http::response<http::string_body>& res, int employee_id);
+
+    // Очередь потоков базы и пул соединений: глубина, ожидание, отказы. В базу не ходит
+    void handleDatabaseStats(const http::request<http::string_body>& req, http::response<http::string_body>& res);
 };
\ No newline at end of file
@@ -0,0 +1,173 @@
+﻿#include "ConnectionPool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+ConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(std::move(other.pool_))
+    , connection_(std::move(other.connection_))
+    , broken_(other.broken_) {
+}
+
+ConnectionPool::Lease& ConnectionPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = std::move(other.pool_);
+        connection_ = std::move(other.connection_);
+        broken_ = other.broken_;
+    }
+    return *this;
+}
+
+ConnectionPool::Lease::~Lease() {
+    release();
+}
+
+void ConnectionPool::Lease::release() {
+    if (pool_ && connection_) {
+        pool_->give_back(std::move(connection_), broken_);
+    }
+    pool_.reset();
+    broken_ = false;
+}
+
+ConnectionPool::ConnectionPool(std::string connection_string, Options options,
+    std::function<void(pqxx::connection&)> on_connect)
+    : connection_string_(std::move(connection_string))
+    , options_(options)
+    , on_connect_(std::move(on_connect)) {
+}
+
+ConnectionPool::~ConnectionPool() = default;
+
+void ConnectionPool::start() {
+    const std::size_t target = std::min(options_.min_size, options_.max_size);
+    for (std::size_t i = 0; i < target; ++i) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++size_;
+        }
+        auto connection = connect();
+        if (!connection) {
+            break;  // База недоступна: остальные откроются по требованию, после паузы
+        }
+        give_back(std::move(connection), false);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (target > 0 && size_ == 0) {
+        throw std::runtime_error("Could not open any database connection");
+    }
+}
+
+ConnectionPool::Lease ConnectionPool::acquire() {
+    const auto started = clock::now();
+    const auto deadline = started + options_.acquire_timeout;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (!idle_.empty()) {
+            Idle entry = std::move(idle_.back());
+            idle_.pop_back();
+            const bool stale = clock::now() - entry.since >= options_.health_check_after;
+            lock.unlock();
+            if (stale && !healthy(*entry.connection)) {
+                give_back(std::move(entry.connection), true);
+                lock.lock();
+                continue;
+            }
+            record_wait(clock::now() - started);
+            return Lease(shared_from_this(), std::move(entry.connection));
+        }
+
+        const auto now = clock::now();
+        if (size_ < options_.max_size && now >= retry_at_) {
+            ++size_;  // Место занято, пока идёт подключение: параллельные acquire его не превысят
+            lock.unlock();
+            auto connection = connect();
+            if (connection) {
+                record_wait(clock::now() - started);
+                return Lease(shared_from_this(), std::move(connection));
+            }
+            lock.lock();
+            continue;
+        }
+        // Ждать нечего: соединений нет, а новое подключение пока запрещено паузой
+        if (now >= deadline || size_ == 0) {
+            ++stats_.timeouts;
+            return {};
+        }
+        auto wake_at = deadline;
+        if (size_ < options_.max_size) {
+            wake_at = std::min(wake_at, retry_at_);  // Пауза кончится раньше — можно подключаться
+        }
+        ++stats_.waiting;
+        available_.wait_until(lock, wake_at);
+        --stats_.waiting;
+    }
+}
+
+std::unique_ptr<pqxx::connection> ConnectionPool::connect() {
+    try {
+        auto connection = std::make_unique<pqxx::connection>(connection_string_);
+        if (on_connect_) {
+            on_connect_(*connection);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.connects;
+        backoff_ = std::chrono::milliseconds(0);
+        retry_at_ = {};
+        return connection;
+    }
+    catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --size_;
+        ++stats_.connect_failures;
+        backoff_ = backoff_.count() == 0 ? options_.backoff_initial : std::min(backoff_ * 2, options_.backoff_max);
+        retry_at_ = clock::now() + backoff_;
+        std::cerr << "[ConnectionPool] Connection failed, next attempt in " << backoff_.count() << " ms: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+bool ConnectionPool::healthy(pqxx::connection& connection) {
+    try {
+        pqxx::nontransaction txn(connection);
+        txn.exec("SELECT 1");
+        return true;
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+}
+
+void ConnectionPool::give_back(std::unique_ptr<pqxx::connection> connection, bool broken) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (broken || !connection->is_open()) {
+            --size_;
+            ++stats_.broken;
+        }
+        else {
+            idle_.push_back({ std::move(connection), clock::now() });
+        }
+    }
+    // Ждущий поток заберёт вернувшееся соединение или займёт освободившееся место
+    available_.notify_one();
+}
+
+void ConnectionPool::record_wait(clock::duration waited) {
+    const auto wait = std::chrono::duration_cast<std::chrono::microseconds>(waited);
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.acquired;
+    stats_.total_wait += wait;
+    stats_.max_wait = std::max(stats_.max_wait, wait);
+}
+
+ConnectionPool::Stats ConnectionPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.size = size_;
+    stats.idle = idle_.size();
+    stats.in_use = size_ - idle_.size();
+    return stats;
+}
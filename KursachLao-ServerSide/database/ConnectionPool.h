@@ -0,0 +1,114 @@
+﻿#pragma once
+
+#include <pqxx/pqxx>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Пул соединений с PostgreSQL. pqxx::connection не потокобезопасен, поэтому соединение
+// выдаётся одному потоку целиком — арендой (Lease), которая вернёт его в пул в деструкторе.
+// При старте открывается min_size соединений, остальные до max_size — по требованию. Соединение,
+// пролежавшее без дела дольше health_check_after, перед выдачей проверяется SELECT 1.
+// Разорванное соединение в пул не возвращается; новое открывается с экспоненциальной
+// паузой после неудач, чтобы лежащая база не получала попытку на каждый запрос.
+// Аренда держит пул (shared_ptr): модуль может закрыть его, пока поток базы дорабатывает запрос
+class ConnectionPool : public std::enable_shared_from_this<ConnectionPool> {
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::size_t min_size = 1;
+        std::size_t max_size = 4;
+        std::chrono::milliseconds acquire_timeout{ 2000 };   // Сколько ждать свободного соединения
+        std::chrono::seconds health_check_after{ 30 };       // Простой, после которого соединение проверяется
+        std::chrono::milliseconds backoff_initial{ 500 };    // Пауза после первой неудачной попытки подключения
+        std::chrono::milliseconds backoff_max{ 30000 };
+    };
+
+    struct Stats {
+        std::size_t size = 0;      // Открыто (и открывается) сейчас
+        std::size_t idle = 0;
+        std::size_t in_use = 0;
+        std::size_t waiting = 0;   // Потоков ждут соединения
+        std::uint64_t acquired = 0;
+        std::uint64_t timeouts = 0;          // Не дождались соединения
+        std::uint64_t connects = 0;          // Успешных подключений, включая переподключения
+        std::uint64_t connect_failures = 0;
+        std::uint64_t broken = 0;            // Выброшено разорванных соединений
+        std::chrono::microseconds total_wait{ 0 };  // Суммарное ожидание аренды
+        std::chrono::microseconds max_wait{ 0 };
+    };
+
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        explicit operator bool() const { return connection_ != nullptr; }
+        pqxx::connection& operator*() const { return *connection_; }
+        pqxx::connection* operator->() const { return connection_.get(); }
+
+        // Соединение оказалось разорванным (pqxx::broken_connection): в пул его не возвращать
+        void invalidate() { broken_ = true; }
+
+    private:
+        friend class ConnectionPool;
+        Lease(std::shared_ptr<ConnectionPool> pool, std::unique_ptr<pqxx::connection> connection)
+            : pool_(std::move(pool)), connection_(std::move(connection)) {
+        }
+        void release();
+
+        std::shared_ptr<ConnectionPool> pool_;
+        std::unique_ptr<pqxx::connection> connection_;
+        bool broken_ = false;
+    };
+
+    // on_connect вызывается для каждого нового соединения до его первой выдачи
+    // (подготовленные запросы, настройки сессии). Исключение из него — неудачное подключение
+    ConnectionPool(std::string connection_string, Options options,
+        std::function<void(pqxx::connection&)> on_connect = {});
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // Открыть min_size соединений. Бросает, если не удалось открыть ни одного
+    void start();
+
+    // Пустая аренда — за acquire_timeout соединение не освободилось или база недоступна.
+    // Пул должен принадлежать shared_ptr
+    Lease acquire();
+
+    Stats stats() const;
+
+private:
+    struct Idle {
+        std::unique_ptr<pqxx::connection> connection;
+        clock::time_point since;
+    };
+
+    std::unique_ptr<pqxx::connection> connect();
+    bool healthy(pqxx::connection& connection);
+    void give_back(std::unique_ptr<pqxx::connection> connection, bool broken);
+    void record_wait(clock::duration waited);
+
+    const std::string connection_string_;
+    const Options options_;
+    const std::function<void(pqxx::connection&)> on_connect_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    std::vector<Idle> idle_;  // Стек: последним вернули — первым выдаём, он точно живой
+    std::size_t size_ = 0;
+    clock::time_point retry_at_{};              // Раньше этого момента новые подключения не пробуем
+    std::chrono::milliseconds backoff_{ 0 };
+    Stats stats_;
+};
@@ -0,0 +1,89 @@
+﻿#include "DatabaseExecutor.h"
+
+#include <algorithm>
+#include <iostream>
+
+DatabaseExecutor::DatabaseExecutor(unsigned threads, std::size_t max_queue)
+    : BaseModule("DatabaseExecutor", -1)
+    , thread_count_(std::max(threads, 1u))
+    , max_queue_(max_queue) {
+    stats_.threads = thread_count_;
+    stats_.queue_limit = max_queue_;
+}
+
+DatabaseExecutor::~DatabaseExecutor() {
+    shutdown();
+}
+
+bool DatabaseExecutor::onInitialize() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+    }
+    threads_.reserve(thread_count_);
+    for (unsigned i = 0; i < thread_count_; ++i) {
+        threads_.emplace_back([this]() { worker(); });
+    }
+    std::cout << "[DatabaseExecutor] " << thread_count_ << " threads, queue limit " << max_queue_ << std::endl;
+    return true;
+}
+
+void DatabaseExecutor::onShutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+    // Невыполненные задачи уходят вместе с кадрами корутин: io_context к этому моменту остановлен
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.clear();
+    stats_.queue_depth = 0;
+}
+
+bool DatabaseExecutor::submit(std::function<void()> work) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || (max_queue_ > 0 && queue_.size() >= max_queue_)) {
+            ++stats_.rejected;
+            return false;
+        }
+        queue_.push_back({ std::move(work), clock::now() });
+        stats_.queue_depth = queue_.size();
+        stats_.max_queue_depth = std::max(stats_.max_queue_depth, queue_.size());
+    }
+    wake_.notify_one();
+    return true;
+}
+
+void DatabaseExecutor::worker() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            task = std::move(queue_.front());
+            queue_.pop_front();
+            const auto waited = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - task.enqueued);
+            stats_.queue_depth = queue_.size();
+            stats_.total_wait += waited;
+            stats_.max_wait = std::max(stats_.max_wait, waited);
+            ++stats_.active;
+        }
+        task.work();  // Исключения fn ловит обёртка из run(), сюда они не доходят
+        std::lock_guard<std::mutex> lock(mutex_);
+        --stats_.active;
+        ++stats_.completed;
+    }
+}
+
+DatabaseExecutor::Stats DatabaseExecutor::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,147 @@
+﻿#pragma once
+
+#include "BaseModule.h"
+
+#include <utility>  // awaitable.hpp из Boost 1.74 использует std::exchange, не подключая <utility>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/execution.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace net = boost::asio;
+
+namespace database_detail {
+    // Сигнатура завершения для use_awaitable: исключение задачи пробрасывается в корутину
+    template<class Result>
+    struct completion {
+        using type = void(std::exception_ptr, Result);
+    };
+    template<>
+    struct completion<void> {
+        using type = void(std::exception_ptr);
+    };
+}
+
+// Отдельный пул потоков для блокирующей работы с базой: pqxx синхронный, и транзакция на потоке
+// io_context держала бы всех клиентов этого потока, включая раздачу статики.
+// Обработчик-корутина отдаёт задачу сюда (co_await run(...)) и засыпает; результат или
+// исключение возвращаются на её executor. Очередь ограничена: если база не успевает, новая
+// задача сразу получает Busy, а не копится без предела
+class DatabaseExecutor : public BaseModule {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // Очередь полна — ответ 503, клиент повторит позже
+    class Busy : public std::runtime_error {
+    public:
+        Busy() : std::runtime_error("Database queue is full") {}
+    };
+
+    struct Stats {
+        unsigned threads = 0;
+        std::size_t queue_depth = 0;      // Ждут свободного потока сейчас
+        std::size_t max_queue_depth = 0;  // Наибольшая глубина с запуска
+        std::size_t queue_limit = 0;
+        std::size_t active = 0;           // Выполняются сейчас
+        std::uint64_t completed = 0;
+        std::uint64_t rejected = 0;       // Пришли при полной очереди
+        std::chrono::microseconds total_wait{ 0 };  // Суммарное ожидание в очереди
+        std::chrono::microseconds max_wait{ 0 };
+    };
+
+    explicit DatabaseExecutor(unsigned threads = 4, std::size_t max_queue = 256);
+    ~DatabaseExecutor() override;
+
+    DatabaseExecutor(const DatabaseExecutor&) = delete;
+    DatabaseExecutor& operator=(const DatabaseExecutor&) = delete;
+
+    // Выполнить fn на потоке базы: co_await executor.run([&] { ... }). Ссылки на кадр корутины
+    // безопасны — она ждёт, пока fn не завершится. fn должна быть копируемой
+    template<class Fn>
+    auto run(Fn fn) -> net::awaitable<std::invoke_result_t<Fn&>> {
+        using Result = std::invoke_result_t<Fn&>;
+        using Signature = typename database_detail::completion<Result>::type;
+        return net::async_initiate<const net::use_awaitable_t<>&, Signature>(
+            [this, fn = std::move(fn)](auto handler) mutable {
+                // Пока задача в пуле, io_context не должен считать, что работы больше нет
+                auto executor = net::prefer(net::get_associated_executor(handler), net::execution::outstanding_work.tracked);
+                auto resume = std::make_shared<decltype(handler)>(std::move(handler));
+                const bool queued = submit([fn = std::move(fn), resume, executor]() mutable {
+                    std::exception_ptr error;
+                    if constexpr (std::is_void_v<Result>) {
+                        try {
+                            fn();
+                        }
+                        catch (...) {
+                            error = std::current_exception();
+                        }
+                        net::post(executor, [resume, error]() { (*resume)(error); });
+                    }
+                    else {
+                        Result result{};
+                        try {
+                            result = fn();
+                        }
+                        catch (...) {
+                            error = std::current_exception();
+                        }
+                        net::post(executor, [resume, error, result = std::move(result)]() mutable {
+                            (*resume)(error, std::move(result));
+                        });
+                    }
+                });
+                if (!queued) {
+                    net::post(executor, [resume]() {
+                        if constexpr (std::is_void_v<Result>) {
+                            (*resume)(std::make_exception_ptr(Busy()));
+                        }
+                        else {
+                            (*resume)(std::make_exception_ptr(Busy()), Result{});
+                        }
+                    });
+                }
+            },
+            net::use_awaitable);
+    }
+
+    Stats stats() const;
+
+protected:
+    bool onInitialize() override;
+    void onShutdown() override;
+
+private:
+    struct Task {
+        std::function<void()> work;
+        clock::time_point enqueued;
+    };
+
+    // false — очередь полна или пул остановлен
+    bool submit(std::function<void()> work);
+    void worker();
+
+    unsigned thread_count_;
+    std::size_t max_queue_;
+    std::vector<std::thread> threads_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Task> queue_;
+    bool stopping_ = false;
+    Stats stats_;
+};
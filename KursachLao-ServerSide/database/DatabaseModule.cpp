@@ -1,9 +1,13 @@
 ﻿#include "DatabaseModule.h"
 
-DatabaseModule::DatabaseModule(boost::asio::io_context& ioc, const std::string& conn_str)
+#include <algorithm>
+
+DatabaseModule::DatabaseModule(const std::string& conn_str, ConnectionPool::Options pool_options,
+    std::function<void(pqxx::connection&)> on_connect)
     : BaseModule("DatabaseModule", -1)
-    , io_context_(ioc)
     , db_connection_string_(conn_str)
+    , pool_options_(pool_options)
+    , pool_(std::make_shared<ConnectionPool>(conn_str, pool_options, std::move(on_connect)))
 {}
 
 DatabaseModule::~DatabaseModule() {
@@ -12,38 +16,67 @@ DatabaseModule::~DatabaseModule() {
 
 bool DatabaseModule::onInitialize() {
     std::cout << "[DatabaseModule] Engage asinc DB initialization...\n";
-    asyncInitializeDatabase();  // Теперь использует внешний io_context_
+    stopping_.store(false);
+    init_thread_ = std::thread([this]() { initializeDatabase(); });
     return true;
 }
 
-void DatabaseModule::asyncInitializeDatabase() {
-    auto strand = boost::asio::make_strand(io_context_);
-
-    boost::asio::post(strand, [this]() {
-        try {
-            conn_ = std::make_unique<pqxx::connection>(db_connection_string_);
-            if (!conn_->is_open()) {
-                throw std::runtime_error("DB connection failded!");
-            }
-
-            pqxx::work txn(*conn_);// FIXME: Будет ли оно постоянно перезаписывать базу данных? Для презентации пока сгодится
-            txn.exec(init_schema_sql_);
-            txn.commit();
-
-            db_ready_.store(true);
-            std::cout << "[DatabaseModule] DataBase ready!\n";
+void DatabaseModule::initializeDatabase() {
+    auto backoff = pool_options_.backoff_initial;
+    while (!createSchema()) {
+        std::cerr << "[DatabaseModule] Next initialisation attempt in " << backoff.count() << " ms" << std::endl;
+        std::unique_lock<std::mutex> lock(init_mutex_);
+        if (init_wake_.wait_for(lock, backoff, [this]() { return stopping_.load(); })) {
+            return;
         }
-        catch (const std::exception& e) {
-            std::cerr << "[DatabaseModule] DataBase initialisation Erorr: " << e.what() << std::endl;
-            db_ready_.store(false);
+        backoff = std::min(backoff * 2, pool_options_.backoff_max);
+    }
+    db_ready_.store(true);
+    if (stopping_.load()) {
+        return;
+    }
+    try {
+        pool_->start();
+        std::cout << "[DatabaseModule] DataBase ready! Pool: " << pool_options_.min_size << "-" << pool_options_.max_size << " connections\n";
+    }
+    catch (const std::exception& e) {
+        // Схема уже есть: соединения пул откроет сам по первым запросам, после своей паузы
+        std::cerr << "[DatabaseModule] Pool start Erorr: " << e.what() << std::endl;
+    }
+}
+
+bool DatabaseModule::createSchema() {
+    // Схема — отдельным соединением до пула: хук пула готовит запросы к её таблицам
+    try {
+        pqxx::connection conn(db_connection_string_);
+        if (!conn.is_open()) {
+            throw std::runtime_error("DB connection failded!");
         }
-        });
-}   
+
+        pqxx::work txn(conn);// FIXME: Будет ли оно постоянно перезаписывать базу данных? Для презентации пока сгодится
+        txn.exec(init_schema_sql_);
+        txn.commit();
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[DatabaseModule] DataBase initialisation Erorr: " << e.what() << std::endl;
+        return false;
+    }
+}
 
 void DatabaseModule::onShutdown() {
     std::cout << "[DatabaseModule] Shutdowning Databese module...\n";
 
-    // Соединение автоматически закроется в деструкторе conn_
-    conn_.reset();
+    // Новых аренд не будет. Соединения закроются вместе с пулом, когда вернётся последняя из выданных
+    {
+        std::lock_guard<std::mutex> lock(init_mutex_);
+        stopping_.store(true);
+    }
+    init_wake_.notify_all();
+    // Пауза между попытками прерывается сразу, а начатое подключение pqxx — нет: недоступная
+    // база задержит выход до таймаута подключения
+    if (init_thread_.joinable()) {
+        init_thread_.join();
+    }
     db_ready_.store(false);
 }
\ No newline at end of file
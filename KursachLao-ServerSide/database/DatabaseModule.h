@@ -1,10 +1,12 @@
 ﻿#pragma once
 
 #include "BaseModule.h"
-#include <boost/asio.hpp>
-#include <boost/asio/strand.hpp>
+#include "ConnectionPool.h"
 #include <pqxx/pqxx>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 #include <atomic>
@@ -14,10 +16,14 @@ class DatabaseModule : public BaseModule {
 private:
     std::string db_connection_string_;
 
-    boost::asio::io_context& io_context_;
-
-    std::unique_ptr<pqxx::connection> conn_;
-    std::atomic<bool> db_ready_{ false };
+    ConnectionPool::Options pool_options_;
+    std::shared_ptr<ConnectionPool> pool_;  // Создаётся в конструкторе и не меняется: читается из потоков базы без блокировок
+    std::atomic<bool> db_ready_{ false };   // Схема создана. Аренды от этого не зависят — только от пула
+    std::atomic<bool> stopping_{ false };   // После shutdown новых аренд нет
+    // Подключение к базе блокирует: на потоке io_context оно держало бы всех его клиентов
+    std::thread init_thread_;
+    std::mutex init_mutex_;
+    std::condition_variable init_wake_;     // Будит паузу между попытками при shutdown
 
     // SQL-скрипт создания схемы
     const std::string init_schema_sql_ = R"(
@@ -109,10 +115,10 @@ private:
     )";
 
 public:
-    // Новый конструктор — принимает io_context по ссылке
     explicit DatabaseModule(
-        boost::asio::io_context& ioc,
-        const std::string& conn_str = "dbname=hr_db user=postgres password=postgres host=127.0.0.1 port=5432"
+        const std::string& conn_str = "dbname=hr_db user=postgres password=postgres host=127.0.0.1 port=5432",
+        ConnectionPool::Options pool_options = {},
+        std::function<void(pqxx::connection&)> on_connect = {}  // Для каждого нового соединения пула: подготовленные запросы
     );
 
     ~DatabaseModule() override;
@@ -120,8 +126,14 @@ public:
     DatabaseModule(const DatabaseModule&) = delete;
     DatabaseModule& operator=(const DatabaseModule&) = delete;
 
-    pqxx::connection* getConnection() {
-        return db_ready_.load() ? conn_.get() : nullptr;
+    // Соединение в аренду на время запроса — вернётся в пул вместе с Lease. Пустая аренда —
+    // база недоступна (пул переподключается с паузой) или все соединения заняты дольше acquire_timeout
+    ConnectionPool::Lease acquireConnection() {
+        return stopping_.load() ? ConnectionPool::Lease{} : pool_->acquire();
+    }
+
+    ConnectionPool::Stats poolStats() const {
+        return pool_->stats();
     }
 
     bool isDatabaseReady() const { return db_ready_.load(); }
@@ -132,6 +144,8 @@ protected:
 
 private:
 
-    // Асинхронная инициализация базы
-    void asyncInitializeDatabase();
+    // Схема и стартовые соединения пула; выполняется на init_thread_ и повторяется, пока база
+    // не ответит, — с паузами пула (backoff_initial, удваивается до backoff_max)
+    void initializeDatabase();
+    bool createSchema();
 };
\ No newline at end of file
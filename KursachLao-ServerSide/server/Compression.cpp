@@ -0,0 +1,72 @@
+﻿#include "Compression.h"
+
+#include <zlib.h>
+#ifdef KURSACH_HAS_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include <iostream>
+
+namespace compression {
+
+    std::optional<std::string> gzip(std::string_view data) {
+        z_stream zs{};
+        // 15 + 16 — окно 32 КБ и gzip-обёртка вместо zlib
+        if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            std::cerr << "gzip: deflateInit2 failed" << std::endl;
+            return std::nullopt;
+        }
+        std::string out;
+        out.resize(deflateBound(&zs, static_cast<uLong>(data.size())));
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        zs.avail_in = static_cast<uInt>(data.size());
+        zs.next_out = reinterpret_cast<Bytef*>(out.data());
+        zs.avail_out = static_cast<uInt>(out.size());
+        int rc = deflate(&zs, Z_FINISH);
+        deflateEnd(&zs);
+        if (rc != Z_STREAM_END) {
+            std::cerr << "gzip: deflate failed (" << rc << ")" << std::endl;
+            return std::nullopt;
+        }
+        out.resize(zs.total_out);
+        return out;
+    }
+
+    std::optional<std::string> brotli(std::string_view data) {
+#ifdef KURSACH_HAS_BROTLI
+        std::string out;
+        size_t out_size = BrotliEncoderMaxCompressedSize(data.size());
+        if (out_size == 0) {
+            return std::nullopt;
+        }
+        out.resize(out_size);
+        if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+            data.size(), reinterpret_cast<const uint8_t*>(data.data()),
+            &out_size, reinterpret_cast<uint8_t*>(out.data()))) {
+            std::cerr << "brotli: compression failed" << std::endl;
+            return std::nullopt;
+        }
+        out.resize(out_size);
+        return out;
+#else
+        (void)data;
+        return std::nullopt;
+#endif
+    }
+
+    bool brotli_available() {
+#ifdef KURSACH_HAS_BROTLI
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool is_compressible_mime(std::string_view mime_type) {
+        return mime_type.rfind("text/", 0) == 0
+            || mime_type.find("javascript") != std::string_view::npos
+            || mime_type.find("json") != std::string_view::npos
+            || mime_type.find("xml") != std::string_view::npos;  // application/xml и image/svg+xml
+    }
+
+}
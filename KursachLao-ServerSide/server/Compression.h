@@ -0,0 +1,20 @@
+﻿#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Сжатие статических файлов при загрузке в кэш.
+// gzip — через zlib (есть всегда), brotli — только если сборка нашла libbrotlienc
+// (KURSACH_HAS_BROTLI). Без неё brotli-варианты берутся только из готовых .br файлов.
+namespace compression {
+
+    std::optional<std::string> gzip(std::string_view data);
+    std::optional<std::string> brotli(std::string_view data);
+
+    bool brotli_available();
+
+    // Стоит ли сжимать ответ с таким Content-Type (текстовые форматы из таблицы MIME)
+    bool is_compressible_mime(std::string_view mime_type);
+
+}
@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace net = boost::asio;
+
+// Дедлайны соединения на одном таймере: отдельно для чтения (простой, заголовок, тело)
+// и для записи. Таймер взводится лениво — по ближайшему дедлайну, а сдвиг дедлайна вперёд
+// стоит одного присваивания: проснувшись раньше срока, таймер просто взводится заново.
+// Не потокобезопасен: живёт на strand (или в потоке шарда) сессии, как и сокет
+class connection_deadline {
+public:
+    using clock = std::chrono::steady_clock;
+    enum phase { read = 0, write = 1 };
+
+    explicit connection_deadline(const net::any_io_executor& executor)
+        : timer_(executor) {
+    }
+
+    // Вызывается на executor сессии, когда один из дедлайнов истёк
+    std::function<void()> on_expire_;
+    // Таймер не продлевает жизнь сессии: без владельца срабатывание игнорируется
+    std::weak_ptr<void> owner_;
+
+    // Отсчитать timeout для фазы с текущего момента. Нулевой timeout — без ограничения
+    void start(phase which, clock::duration timeout) {
+        if (timeout <= clock::duration::zero()) {
+            stop(which);
+            return;
+        }
+        deadlines_[which] = clock::now() + timeout;
+        if (!waiting_ || deadlines_[which] < armed_) {
+            arm(deadlines_[which]);
+        }
+    }
+
+    void stop(phase which) {
+        deadlines_[which] = clock::time_point::max();
+    }
+
+private:
+    void arm(clock::time_point at) {
+        armed_ = at;
+        waiting_ = true;
+        timer_.expires_at(at);  // Прежнее ожидание отменяется, его поколение устаревает
+        timer_.async_wait([this, owner = owner_, generation = ++generation_](boost::system::error_code ec) {
+            auto self = owner.lock();
+            if (!self || ec || generation != generation_) {
+                return;
+            }
+            on_timer();
+        });
+    }
+
+    void on_timer() {
+        waiting_ = false;
+        const auto next = std::min(deadlines_[read], deadlines_[write]);
+        if (next == clock::time_point::max()) {
+            return;  // Ждать нечего — взведётся при следующем start()
+        }
+        if (next > clock::now()) {
+            arm(next);
+            return;
+        }
+        stop(read);
+        stop(write);
+        if (on_expire_) {
+            on_expire_();
+        }
+    }
+
+    net::steady_timer timer_;
+    clock::time_point deadlines_[2] = { clock::time_point::max(), clock::time_point::max() };
+    clock::time_point armed_ = clock::time_point::max();
+    bool waiting_ = false;
+    std::uint64_t generation_ = 0;
+};
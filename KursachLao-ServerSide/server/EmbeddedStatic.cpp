@@ -0,0 +1,16 @@
+﻿#include "EmbeddedStatic.h"
+
+// Заглушка для сборки без KURSACH_EMBED_STATIC: настоящая таблица генерируется в каталоге сборки
+#ifndef KURSACH_EMBEDDED_STATIC
+namespace embedded_static {
+
+    std::span<const Asset> assets() {
+        return {};
+    }
+
+    const Asset* find(std::string_view) {
+        return nullptr;
+    }
+
+}
+#endif
@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// Статика, вшитая в бинарник при сборке (опция CMake KURSACH_EMBED_STATIC).
+// Таблица и байты файлов генерируются утилитой tools/embed_static в embedded_static.cpp;
+// без опции собирается заглушка EmbeddedStatic.cpp с пустой таблицей.
+namespace embedded_static {
+
+#ifdef KURSACH_EMBEDDED_STATIC
+    inline constexpr bool compiled_in = true;
+#else
+    inline constexpr bool compiled_in = false;
+#endif
+
+    struct Asset {
+        std::string_view path;       // Относительно каталога static, разделитель '/'
+        const unsigned char* data;   // constexpr-массив в .rodata — в кучу не копируется
+        std::size_t size;
+        std::int64_t mtime;          // Время изменения исходного файла, секунды Unix
+
+        std::string_view bytes() const {
+            return std::string_view(reinterpret_cast<const char*>(data), size);
+        }
+    };
+
+    // Хэш для идеальной таблицы: FNV-1a с примешанным seed. Одна и та же функция
+    // используется генератором и при поиске, поэтому живёт в заголовке
+    constexpr std::uint32_t hash(std::string_view key, std::uint32_t seed) {
+        std::uint32_t h = 2166136261u ^ (seed * 16777619u);
+        for (char c : key) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 16777619u;
+        }
+        h ^= h >> 15;
+        h *= 0x2c1b3c6du;
+        h ^= h >> 12;
+        return h;
+    }
+
+    std::span<const Asset> assets();
+    // Поиск по относительному пути: один хэш корзины, один хэш со смещением, одно сравнение строк
+    const Asset* find(std::string_view path);
+
+}
@@ -1,4 +1,6 @@
 ﻿#include "FileCache.h"
+#include "Compression.h"
+#include "HttpDate.h"
 #include <iostream>
 #include <fstream>
 #include <algorithm>  // Для std::transform
@@ -7,6 +9,13 @@
 #include <ctime>
 #include <unordered_map>  // Для mime_types
 #include <chrono>  // Уже в .h, но для ясности
+#include <cctype>
+#include <cstdio>
+#include <thread>
+#include <unordered_set>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 namespace fs = std::filesystem;
 
@@ -45,31 +54,203 @@ namespace {
         }
         return std::nullopt;
     }
+
+    // Сериализация заголовка ответа в том же виде, в каком его собрал бы RequestHandler.
+    // Для 304 тела нет, поэтому без Content-Type/Content-Length
+    std::string build_wire_head(const char* status_line, const std::string& mime_type, size_t content_length,
+        bool keep_alive, const char* content_encoding, bool vary_encoding,
+        const std::string& etag, const std::string& last_modified, bool has_body, bool accept_ranges, const char* cache_control) {
+        std::string head;
+        head.reserve(320 + mime_type.size());
+        head += "HTTP/1.1 ";
+        head += status_line;
+        head += "\r\nServer: ModularServer\r\nConnection: ";
+        head += keep_alive ? "keep-alive" : "close";
+        if (has_body) {
+            head += "\r\nContent-Type: ";
+            head += mime_type;
+        }
+        head += "\r\nCache-Control: ";
+        head += cache_control;
+        head += "\r\nETag: ";
+        head += etag;
+        head += "\r\nLast-Modified: ";
+        head += last_modified;
+        head += "\r\n";
+        if (content_encoding) {
+            head += "Content-Encoding: ";
+            head += content_encoding;
+            head += "\r\n";
+        }
+        if (vary_encoding) {
+            head += "Vary: Accept-Encoding\r\n";
+        }
+        if (accept_ranges) {
+            head += "Accept-Ranges: bytes\r\n";
+        }
+        if (has_body) {
+            head += "Content-Length: ";
+            head += std::to_string(content_length);
+            head += "\r\n";
+        }
+        head += "\r\n";
+        return head;
+    }
+
+    // FNV-1a 64 — быстрый некриптографический хэш, для ETag его достаточно
+    constexpr std::uint64_t fnv1a_offset = 14695981039346656037ull;
+
+    std::uint64_t fnv1a_update(std::uint64_t hash, std::string_view data) {
+        for (unsigned char c : data) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string hash_hex(std::uint64_t hash) {
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(hash));
+        return buf;
+    }
+
+    std::string content_hash_hex(std::string_view data) {
+        return hash_hex(fnv1a_update(fnv1a_offset, data));
+    }
+
+    // Тот же хэш, но файл читается кусками — при сканировании содержимое целиком не держим
+    std::optional<std::string> file_content_hash(const fs::path& file_path) {
+        std::ifstream file(file_path.string(), std::ios::binary);
+        if (!file) {
+            return std::nullopt;
+        }
+        std::uint64_t hash = fnv1a_offset;
+        char buffer[64 * 1024];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+            hash = fnv1a_update(hash, std::string_view(buffer, static_cast<size_t>(file.gcount())));
+        }
+        if (file.bad()) {
+            return std::nullopt;
+        }
+        return hash_hex(hash);
+    }
+
+    // Сколько hex-символов хэша попадает в имя: 48 бит — коллизии между версиями одного файла исключены
+    constexpr size_t fingerprint_length = 12;
+
+    bool is_html_mime(std::string_view mime_type) {
+        return mime_type.substr(0, 9) == "text/html";
+    }
+
+    // Отображение файла в память только для чтения. Страницы делит page cache ядра, в RSS процесса
+    // они не висят. Регион остаётся валидным и после закрытия file_mapping. Файл должен заменяться
+    // только переименованием (старый inode остаётся отображённым): обрезка на месте под отображением
+    // даёт SIGBUS при чтении за новым концом. Поэтому при работающем FileWatcher ServerConfig
+    // выключает mmap — там файлы правят на лету чем угодно
+    std::shared_ptr<const boost::interprocess::mapped_region> map_file_readonly(const fs::path& file_path) {
+        namespace bip = boost::interprocess;
+        try {
+            bip::file_mapping mapping(file_path.string().c_str(), bip::read_only);
+            return std::make_shared<const bip::mapped_region>(mapping, bip::read_only);
+        }
+        catch (const bip::interprocess_exception& e) {
+            std::cerr << "Error mapping file " << file_path << ": " << e.what() << std::endl;
+            return nullptr;
+        }
+    }
+
+    // Glob для маршрутов прогрева: '*' — любая подстрока (в том числе с '/'), '?' — ровно один символ
+    bool glob_match(std::string_view pattern, std::string_view text) {
+        size_t p = 0, t = 0;
+        size_t star = std::string_view::npos, star_text = 0;
+        while (t < text.size()) {
+            if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+                ++p;
+                ++t;
+            }
+            else if (p < pattern.size() && pattern[p] == '*') {
+                star = p++;
+                star_text = t;
+            }
+            else if (star != std::string_view::npos) {
+                p = star + 1;
+                t = ++star_text;
+            }
+            else {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == '*') {
+            ++p;
+        }
+        return p == pattern.size();
+    }
+
+    // Сжатая копия рядом с файлом (style.css.gz, style.css.br) — приоритетнее сжатия на лету
+    bool is_precompressed_sibling(const fs::path& file_path) {
+        auto ext = file_path.extension().string();
+        if (ext != ".gz" && ext != ".br") {
+            return false;
+        }
+        std::error_code ec;
+        auto original = file_path;
+        original.replace_extension();
+        return fs::is_regular_file(original, ec);
+    }
 }
 
 // Конструктор (как оригинал, с вызовом rebuild_file_map)
-FileCache::FileCache(const std::string& base_dir, bool enable_cache, size_t max_cache, int chache_mode)
-    : BaseModule("File Cache Module"), fileCacheMode(chache_mode), cache_enabled_(enable_cache), max_cache_size_(max_cache), total_cache_size_(0) {
+FileCache::FileCache(const std::string& base_dir, bool enable_cache, size_t max_cache_bytes, size_t max_file_bytes, int chache_mode,
+    Source source)
+    : BaseModule("File Cache Module"), fileCacheMode(chache_mode), source_(source), cache_enabled_(enable_cache),
+    max_cache_size_(max_cache_bytes), max_file_size_(max_file_bytes), total_cache_size_(0) {
     base_directory_ = fs::absolute(base_dir);
-    if (!fs::exists(base_directory_) || !fs::is_directory(base_directory_)) {
+    if (source_ == Source::Embedded) {
+        if (!embedded_static::compiled_in) {
+            throw std::runtime_error("Embedded static is not compiled in: rebuild with -DKURSACH_EMBED_STATIC=ON");
+        }
+    }
+    else if (!fs::exists(base_directory_) || !fs::is_directory(base_directory_)) {
         throw std::runtime_error("Base directory does not exist or is not accessible: " + base_dir);
     }
+    publish(std::make_shared<RouteMap>(), std::make_shared<CacheIndex>());
     rebuild_file_map();  // Инициализируем карту маршрутов
     std::cout << "FileCache constructed for " << base_directory_ << std::endl;
 }
 
 // onInitialize (модульный: лог + проверка)
 bool FileCache::onInitialize() {
-    if (route_to_path_.empty()) {
+    const size_t routes_count = snapshot()->routes->size();
+    if (routes_count == 0) {
         std::cerr << "Warning: No routes mapped in FileCache for " << base_directory_ << std::endl;
         return false;
     }
-    std::cout << "FileCache onInitialize: " << route_to_path_.size() << " routes ready." << std::endl;
+    std::cout << "FileCache onInitialize: " << routes_count << " routes ready." << std::endl;
+    if (warmup_.enabled && cache_enabled_) {
+        warmup_stop_ = false;
+        if (warmup_.background) {
+            warmup_thread_ = std::thread(&FileCache::warm_up, this);
+        }
+        else {
+            warm_up();  // Сервер начнёт принимать соединения только после прогрева
+        }
+    }
     return true;
 }
 
+FileCache::~FileCache() {
+    warmup_stop_ = true;
+    if (warmup_thread_.joinable()) {
+        warmup_thread_.join();
+    }
+}
+
 // onShutdown (модульный: clear + лог)
 void FileCache::onShutdown() {
+    warmup_stop_ = true;
+    if (warmup_thread_.joinable()) {
+        warmup_thread_.join();
+    }
     clear_cache();
     std::cout << "FileCache onShutdown: Cache cleared." << std::endl;
 }
@@ -150,6 +331,11 @@ std::string FileCache::normalize_route(const fs::path& file_path) const {
         // Если не можем получить относительный путь, используем полный
         return "/invalid_path";
     }
+    return route_for_relative(relative_path);
+}
+
+// Маршрут по пути относительно base_directory_ — общая часть для диска и вшитой статики
+std::string FileCache::route_for_relative(const fs::path& relative_path) const {
     std::string filename;
     std::string route = "/";
 
@@ -191,20 +377,14 @@ std::string FileCache::normalize_route(const fs::path& file_path) const {
     return route;
 }
 
-// Сканирование директории (оригинал)
-void FileCache::scan_directory(const fs::path& directory) {
+// Сканирование директории (оригинал). Блокировку не берёт — пишет в переданную карту
+void FileCache::scan_directory(const fs::path& directory, RouteMap& routes) const {
     try {
         for (const auto& entry : fs::recursive_directory_iterator(directory)) {
-            if (fs::is_regular_file(entry.path())) {
-                std::string route = normalize_route(entry.path());
-                if (route != "/invalid_path") {
-                    route_to_path_[route] = entry.path().string();
-                    // Также добавляем альтернативный вариант без конечного слэша
-                    if (route.back() == '/' && route != "/") {
-                        std::string alt_route = route.substr(0, route.length() - 1);
-                        route_to_path_[alt_route] = entry.path().string();
-                    }
-                }
+            std::string route;
+            RouteEntry route_entry;
+            if (make_route_entry(entry.path(), route, route_entry)) {
+                set_route(routes, route, route_entry);
             }
         }
     }
@@ -213,174 +393,791 @@ void FileCache::scan_directory(const fs::path& directory) {
     }
 }
 
-// Загрузка файла с диска (оригинал)
-std::optional<FileCache::CachedFile> FileCache::load_file_from_disk(const fs::path& file_path) const {
-    auto content_opt = read_file_contents(file_path);
-    if (!content_opt) {
-        return std::nullopt;
+// Карта маршрутов из таблицы вшитой статики — без единого обращения к диску
+void FileCache::scan_embedded(RouteMap& routes) const {
+    for (const auto& asset : embedded_static::assets()) {
+        const std::string_view path = asset.path;
+        // .gz/.br-копия — не отдельный маршрут, а готовое представление оригинала
+        if ((path.ends_with(".gz") || path.ends_with(".br")) && embedded_static::find(path.substr(0, path.size() - 3))) {
+            continue;
+        }
+        const fs::path relative_path(std::string{ path });
+        RouteEntry route_entry;
+        route_entry.path = (base_directory_ / relative_path).string();
+        route_entry.size = asset.size;
+        route_entry.last_modified = std::chrono::system_clock::time_point(std::chrono::seconds(asset.mtime));
+        route_entry.asset = &asset;
+        std::string route = route_for_relative(relative_path);
+        if (fingerprint_assets_ && route.back() != '/' && !is_html_mime(get_mime_type(relative_path.extension().string()))) {
+            route_entry.fingerprint = content_hash_hex(asset.bytes()).substr(0, fingerprint_length);
+        }
+        set_route(routes, route, route_entry);
     }
+}
+
+const embedded_static::Asset* FileCache::embedded_asset(const fs::path& file_path) const {
+    return embedded_static::find(file_path.lexically_relative(base_directory_).generic_string());
+}
+
+// Маршрут и метаданные одного файла; false — файл не раздаётся (нет, каталог, .gz/.br-копия)
+bool FileCache::make_route_entry(const fs::path& file_path, std::string& route, RouteEntry& route_entry) const {
+    std::error_code ec;
+    if (!fs::is_regular_file(file_path, ec) || is_precompressed_sibling(file_path)) {
+        return false;
+    }
+    route = normalize_route(file_path);
+    if (route == "/invalid_path") {
+        return false;
+    }
+    route_entry.path = file_path.string();
+    std::error_code size_ec;
+    route_entry.size = fs::file_size(file_path, size_ec);
+    if (size_ec) {
+        route_entry.size = 0;
+    }
+    std::error_code time_ec;
+    auto ftime = fs::last_write_time(file_path, time_ec);
+    if (!time_ec) {
+        route_entry.write_time = ftime;
+        route_entry.last_modified = file_time_to_system_time(ftime);
+    }
+    // HTML не получает хэш в имени: на страницы ведут обычные ссылки, а их содержимое зависит от ресурсов
+    if (fingerprint_assets_ && route.back() != '/' && !is_html_mime(get_mime_type(file_path.extension().string()))) {
+        if (auto hash = file_content_hash(file_path)) {
+            route_entry.fingerprint = hash->substr(0, fingerprint_length);
+        }
+    }
+    return true;
+}
+
+void FileCache::set_route(RouteMap& routes, const std::string& route, const RouteEntry& route_entry) {
+    routes[route] = route_entry;
+    // Также добавляем альтернативный вариант без конечного слэша
+    if (route.back() == '/' && route != "/") {
+        routes[route.substr(0, route.length() - 1)] = route_entry;
+    }
+    // Вариант с хэшем ведёт на тот же файл, но отдаётся как immutable
+    if (!route_entry.fingerprint.empty() && !route_entry.immutable) {
+        RouteEntry fingerprinted = route_entry;
+        fingerprinted.immutable = true;
+        routes[fingerprinted_route(route, route_entry.fingerprint)] = std::move(fingerprinted);
+    }
+}
+
+// /modules/dataCache.js -> /modules/dataCache.<hash>.js; без расширения (CleanFileType) хэш дописывается в конец
+std::string FileCache::fingerprinted_route(const std::string& route, std::string_view fingerprint) {
+    const size_t name_begin = route.rfind('/') + 1;
+    const size_t dot = route.rfind('.');
+    const size_t insert_at = dot != std::string::npos && dot > name_begin ? dot : route.size();
+    std::string result = route.substr(0, insert_at);
+    result += '.';
+    result += fingerprint;
+    result += route.substr(insert_at);
+    return result;
+}
+
+void FileCache::erase_route(RouteMap& routes, CacheIndex& files, const std::string& route) {
+    auto drop = [&](const std::string& key) {
+        routes.erase(key);
+        cache_erase(files, key);
+    };
+    auto route_it = routes.find(route);
+    if (route_it != routes.end() && !route_it->second.fingerprint.empty() && !route_it->second.immutable) {
+        drop(fingerprinted_route(route, route_it->second.fingerprint));
+    }
+    drop(route);
+    if (route.back() == '/' && route != "/") {
+        drop(route.substr(0, route.length() - 1));
+    }
+}
+
+void FileCache::drop_rewritten_pages(CacheIndex& files) {
+    auto rewritten = files.keys_if([](const std::string&, const std::shared_ptr<CacheEntry>& entry) {
+        return entry->file->links_rewritten;
+    });
+    for (const auto& route : rewritten) {
+        cache_erase(files, route);
+    }
+}
+
+// Подмена src="..."/href="..." на маршруты с хэшем. Относительные ссылки разрешаются от каталога
+// страницы, query и фрагмент сохраняются. Внешние ссылки и неизвестные маршруты не трогаем
+std::string FileCache::rewrite_asset_links(std::string_view html, const std::string& page_directory) const {
+    auto current = snapshot();
+    auto fingerprinted_url = [&](std::string_view url) -> std::optional<std::string> {
+        if (url.empty() || url.front() == '#' || url.substr(0, 2) == "//") {
+            return std::nullopt;
+        }
+        const size_t suffix_begin = std::min(url.find('?'), url.find('#'));
+        std::string_view path = url.substr(0, suffix_begin);
+        if (path.empty() || path.find(':') != std::string_view::npos) {
+            return std::nullopt;  // http:, mailto:, data: и т.п.
+        }
+        std::string resolved = path.front() == '/' ? std::string(path) : page_directory + std::string(path);
+        resolved = fs::path(resolved).lexically_normal().generic_string();
+        auto route_it = current->routes->find(resolved);
+        if (route_it == current->routes->end() || route_it->second.fingerprint.empty() || route_it->second.immutable) {
+            return std::nullopt;
+        }
+        std::string rewritten = fingerprinted_route(resolved, route_it->second.fingerprint);
+        if (suffix_begin != std::string_view::npos) {
+            rewritten += url.substr(suffix_begin);
+        }
+        return rewritten;
+    };
+
+    std::string result;
+    result.reserve(html.size() + 256);
+    size_t copied = 0;
+    for (size_t eq = html.find('='); eq != std::string_view::npos; eq = html.find('=', eq + 1)) {
+        if (eq + 1 >= html.size() || (html[eq + 1] != '"' && html[eq + 1] != '\'')) {
+            continue;
+        }
+        const std::string_view name = html.substr(0, eq);
+        const size_t name_length = name.ends_with("src") ? 3 : name.ends_with("href") ? 4 : 0;
+        if (name_length == 0 || eq <= name_length || !std::isspace(static_cast<unsigned char>(html[eq - name_length - 1]))) {
+            continue;
+        }
+        const size_t value_begin = eq + 2;
+        const size_t value_end = html.find(html[eq + 1], value_begin);
+        if (value_end == std::string_view::npos) {
+            break;
+        }
+        if (auto rewritten = fingerprinted_url(html.substr(value_begin, value_end - value_begin))) {
+            result.append(html.substr(copied, value_begin - copied));
+            result += *rewritten;
+            copied = value_end;
+        }
+        eq = value_end;
+    }
+    result.append(html.substr(copied));
+    return result;
+}
+
+// Загрузка файла с диска (оригинал). Для Source::Embedded байты берутся из бинарника
+FileCache::FileHandle FileCache::load_file_from_disk(const fs::path& file_path, std::string_view fingerprint) const {
+    const size_t identity_index = static_cast<size_t>(Encoding::Identity);
     try {
-        CachedFile cached_file;
-        cached_file.content = std::move(*content_opt);
-        cached_file.size = cached_file.content.size();
-        cached_file.file_path = file_path;
-        cached_file.mime_type = get_mime_type(file_path.extension().string());
+        auto cached_file = std::make_shared<CachedFile>();
+        // CachedFile после заполнения не перемещается, поэтому content может смотреть в storage
+        auto& identity = cached_file->representations[identity_index].emplace();
+
+        // Вшитый файл не копируется: content смотрит прямо в .rodata, как при mmap
+        const embedded_static::Asset* asset = nullptr;
+        if (source_ == Source::Embedded) {
+            asset = embedded_asset(file_path);
+            if (!asset) {
+                return nullptr;
+            }
+            identity.content = asset->bytes();
+        }
+
+        // Большие файлы — через mmap: тело ответа читается прямо из page cache
+        std::error_code size_ec;
+        const std::uintmax_t disk_size = asset ? 0 : fs::file_size(file_path, size_ec);
+        const size_t mmap_threshold = mmap_threshold_;
+        if (!asset && mmap_threshold != 0 && !size_ec && disk_size >= mmap_threshold) {
+            if (auto region = map_file_readonly(file_path)) {
+                identity.content = std::string_view(static_cast<const char*>(region->get_address()), region->get_size());
+                cached_file->mapping = std::move(region);
+            }
+        }
+        if (!asset && !cached_file->mapping) {
+            auto content_opt = read_file_contents(file_path);
+            if (!content_opt) {
+                return nullptr;
+            }
+            identity.storage = std::move(*content_opt);
+            identity.content = identity.storage;
+        }
         // Время последнего изменения файла
-        auto ftime = fs::last_write_time(file_path);
-        cached_file.last_modified = file_time_to_system_time(ftime);
-        cached_file.last_accessed = std::chrono::system_clock::now();
-        return cached_file;
+        std::chrono::system_clock::time_point last_modified;
+        if (asset) {
+            last_modified = std::chrono::system_clock::time_point(std::chrono::seconds(asset->mtime));
+        }
+        else {
+            last_modified = file_time_to_system_time(fs::last_write_time(file_path));
+        }
+        return assemble_cached_file(std::move(cached_file), file_path, last_modified, asset, fingerprint,
+            [&file_path](const char* suffix) {
+                auto sibling = file_path;
+                sibling += suffix;
+                return read_file_contents(sibling);
+            });
     }
     catch (const std::exception& e) {
         std::cerr << "Error creating cached file for " << file_path << ": " << e.what() << std::endl;
-        return std::nullopt;
+        return nullptr;
     }
 }
 
-// Вытеснение файлов при переполнении кэша (оригинал)
-void FileCache::evict_if_needed() {
-    if (file_cache_.size() <= max_cache_size_) {
-        return;
+// Общая часть загрузки: identity уже заполнен (куча, mmap или бинарник). Переписывает ссылки в HTML,
+// считает хэш, строит сжатые варианты и готовые заголовки
+FileCache::FileHandle FileCache::assemble_cached_file(std::shared_ptr<CachedFile> cached_file, const fs::path& file_path,
+    std::chrono::system_clock::time_point last_modified, const embedded_static::Asset* asset, std::string_view fingerprint,
+    const SiblingReader& read_sibling) const {
+    const size_t identity_index = static_cast<size_t>(Encoding::Identity);
+    auto& identity = *cached_file->representations[identity_index];
+    cached_file->size = identity.content.size();
+    cached_file->file_path = file_path;
+    cached_file->mime_type = get_mime_type(file_path.extension().string());
+    // Ссылки на ресурсы — на маршруты с хэшем. Переписанная страница живёт в куче,
+    // а готовые .gz/.br рядом с ней больше не соответствуют содержимому
+    if (fingerprint_assets_ && is_html_mime(cached_file->mime_type)) {
+        const fs::path page_directory = file_path.lexically_relative(base_directory_).parent_path();
+        std::string rewritten = rewrite_asset_links(identity.content,
+            page_directory.empty() ? std::string("/") : "/" + page_directory.generic_string() + "/");
+        if (rewritten != identity.content) {
+            identity.storage = std::move(rewritten);
+            identity.content = identity.storage;
+            cached_file->mapping.reset();
+            cached_file->size = identity.content.size();
+        }
+        cached_file->links_rewritten = true;
+    }
+    cached_file->last_modified = last_modified;
+    cached_file->last_modified_http = http_date::format(cached_file->last_modified);
+    cached_file->content_hash = content_hash_hex(identity.content);
+    // Файл мог измениться после сканирования — тогда immutable обещать нельзя
+    cached_file->immutable = !fingerprint.empty() && cached_file->content_hash.compare(0, fingerprint.size(), fingerprint) == 0;
+
+    // Сжатые варианты для текстовых форматов: готовый .gz/.br рядом с файлом или сжатие при загрузке.
+    // Вариант храним только если он действительно меньше оригинала
+    if (compression_enabled_ && compression::is_compressible_mime(cached_file->mime_type)) {
+        const std::string_view raw = identity.content;
+        auto add_variant = [&](Encoding encoding, const char* suffix,
+            std::optional<std::string>(*compress)(std::string_view)) {
+            std::optional<std::string> encoded;
+            // Переписанную страницу сжимаем заново: готовая копия собрана из исходного HTML
+            if (asset && !cached_file->links_rewritten) {
+                // Вшитая .gz/.br-копия тоже отдаётся без копирования
+                const auto* sibling = embedded_static::find(std::string(asset->path) + suffix);
+                if (sibling && sibling->size < raw.size()) {
+                    auto& variant = cached_file->representations[static_cast<size_t>(encoding)].emplace();
+                    variant.content = sibling->bytes();
+                    cached_file->vary_encoding = true;
+                    return;
+                }
+            }
+            else if (!asset && !cached_file->links_rewritten) {
+                encoded = read_sibling(suffix);
+            }
+            if (!encoded) {
+                encoded = compress(raw);
+            }
+            if (encoded && encoded->size() < raw.size()) {
+                auto& variant = cached_file->representations[static_cast<size_t>(encoding)].emplace();
+                variant.storage = std::move(*encoded);
+                variant.content = variant.storage;
+                cached_file->vary_encoding = true;
+            }
+        };
+        add_variant(Encoding::Gzip, ".gz", &compression::gzip);
+        add_variant(Encoding::Brotli, ".br", &compression::brotli);
     }
-    // Находим файл с самым старым временем доступа
-    auto oldest = file_cache_.begin();
-    for (auto it = file_cache_.begin(); it != file_cache_.end(); ++it) {
-        if (it->second.last_accessed < oldest->second.last_accessed) {
-            oldest = it;
+
+    // Заголовки не меняются от запроса к запросу — собираем их заранее для каждого представления
+    static const char* const status_lines[] = { "200 OK", "404 Not Found", "304 Not Modified" };
+    for (size_t enc = 0; enc < static_cast<size_t>(Encoding::Count); ++enc) {
+        auto& representation = cached_file->representations[enc];
+        if (!representation) {
+            continue;
+        }
+        const char* content_encoding = enc == identity_index ? nullptr : encoding_name(static_cast<Encoding>(enc));
+        // У каждого представления свой ETag — сжатые байты отличаются от исходных
+        representation->etag = "\"" + cached_file->content_hash
+            + (content_encoding ? std::string("-") + content_encoding : std::string()) + "\"";
+        for (size_t kind = 0; kind < static_cast<size_t>(ResponseKind::Count); ++kind) {
+            const bool has_body = kind != static_cast<size_t>(ResponseKind::NotModified);
+            const bool accept_ranges = kind == static_cast<size_t>(ResponseKind::Ok);
+            for (int keep_alive = 0; keep_alive < 2; ++keep_alive) {
+                representation->wire_heads[kind][keep_alive] = build_wire_head(status_lines[kind], cached_file->mime_type,
+                    representation->content.size(), keep_alive != 0, content_encoding, cached_file->vary_encoding,
+                    representation->etag, cached_file->last_modified_http, has_body, accept_ranges, cached_file->cache_control());
+            }
+        }
+    }
+    for (const auto& representation : cached_file->representations) {
+        if (!representation) {
+            continue;
+        }
+        cached_file->memory_size += representation->storage.size() + representation->etag.size();
+        for (const auto& heads : representation->wire_heads) {
+            cached_file->memory_size += heads[0].size() + heads[1].size();
+        }
+    }
+    cached_file->memory_size += sizeof(CachedFile) + cached_file->mime_type.size() + cached_file->last_modified_http.size();
+    return cached_file;
+}
+
+// Публикация нового снимка. Старый доживёт, пока его держат читатели
+void FileCache::publish(std::shared_ptr<const RouteMap> routes, std::shared_ptr<const CacheIndex> files) {
+    auto next = std::make_shared<Snapshot>();
+    auto previous = snapshot();
+    if (previous && previous->routes == routes) {
+        next->route_filter = previous->route_filter;  // Изменился только индекс кэша
+    }
+    else {
+        auto filter = std::make_shared<RouteFilter>(routes->size());
+        for (const auto& [route, route_entry] : *routes) {
+            filter->add(route);
+        }
+        next->route_filter = std::move(filter);
+    }
+    next->routes = std::move(routes);
+    next->files = std::move(files);
+    snapshot_.store(std::move(next), std::memory_order_release);
+    generation_.fetch_add(1, std::memory_order_release);
+}
+
+bool FileCache::fits(const CachedFile& file) const {
+    return file.memory_size <= max_cache_size_ && (max_file_size_ == 0 || file.size <= max_file_size_);
+}
+
+// Вытеснение с хвоста LRU, пока новая запись размером incoming не впишется в бюджет
+void FileCache::evict_if_needed(CacheIndex& files, size_t incoming) {
+    while (total_cache_size_ + incoming > max_cache_size_) {
+        std::string victim;
+        {
+            std::lock_guard lru_lock(lru_mutex_);
+            if (lru_.empty()) {
+                return;
+            }
+            victim = lru_.back();
+        }
+        // Клиенты, которые ещё пишут этот файл, держат свой FileHandle
+        if (!cache_erase(files, victim)) {
+            std::lock_guard lru_lock(lru_mutex_);
+            lru_.pop_back();
+        }
+    }
+}
+
+// Кладёт файл в индекс, освобождая место; false — файл больше бюджета или лимита на файл
+bool FileCache::cache_insert(CacheIndex& files, const std::string& route, FileHandle file) {
+    cache_erase(files, route);  // Старую версию не трогаем: её FileHandle могут держать незавершённые ответы
+    if (!fits(*file)) {
+        return false;
+    }
+    const size_t size = file->memory_size;
+    evict_if_needed(files, size);
+    auto entry = std::make_shared<CacheEntry>(std::move(file));
+    {
+        std::lock_guard lru_lock(lru_mutex_);
+        lru_.push_front(route);
+        entry->lru_position = lru_.begin();
+        entry->in_lru = true;
+    }
+    files.insert_or_assign(route, std::move(entry));
+    total_cache_size_ += size;
+    return true;
+}
+
+bool FileCache::cache_erase(CacheIndex& files, const std::string& route) {
+    const auto* found = files.find(route);
+    if (!found) {
+        return false;
+    }
+    auto& entry = **found;
+    total_cache_size_ -= entry.file->memory_size;
+    {
+        std::lock_guard lru_lock(lru_mutex_);
+        if (entry.in_lru) {
+            lru_.erase(entry.lru_position);
+            entry.in_lru = false;  // Запись ещё видна в старых снимках — читатель не должен трогать её узел
         }
     }
-    // Удаляем его
-    if (oldest != file_cache_.end()) {
-        total_cache_size_ -= oldest->second.size;
-        file_cache_.erase(oldest);
+    files.erase(route);
+    return true;
+}
+
+// Попадание: запись в начало LRU. Если список сейчас занят другим потоком — не ждём,
+// LRU станет чуть менее точным, зато чтение никогда не блокируется
+void FileCache::touch_entry(CacheEntry& entry) {
+    entry.touch();
+    std::unique_lock lru_lock(lru_mutex_, std::try_to_lock);
+    if (lru_lock.owns_lock() && entry.in_lru) {
+        lru_.splice(lru_.begin(), lru_, entry.lru_position);
     }
 }
 
+// Прогрев: загрузка выбранных маршрутов пулом потоков. Чтение, сжатие и хэширование идут
+// параллельно без блокировок, под write_mutex_ — только вставка пачками по batch_files файлов. Файлы грузятся от маленьких
+// к большим, чтобы в бюджет поместилось как можно больше; не влезающие пропускаются без вытеснения
+void FileCache::warm_up() {
+    const auto started = std::chrono::steady_clock::now();
+    auto current = snapshot();
+
+    std::vector<std::pair<std::string, const RouteEntry*>> jobs;
+    std::unordered_set<std::string> seen_paths;  // "/dir/" и "/dir" ведут на один файл — грузим его один раз
+    for (const auto& [route, route_entry] : *current->routes) {
+        // Для ресурсов с хэшем греем вариант с хэшем — на него ссылаются переписанные страницы
+        if (!route_entry.fingerprint.empty() && !route_entry.immutable) {
+            continue;
+        }
+        if (!glob_match(warmup_.pattern, route) || !seen_paths.insert(route_entry.path).second) {
+            continue;
+        }
+        if (get_streamed_file(route)) {
+            continue;  // Отдаётся потоком с диска и в кэш не попадает
+        }
+        jobs.emplace_back(route, &route_entry);
+    }
+    std::sort(jobs.begin(), jobs.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second->size < rhs.second->size;
+    });
+
+    std::atomic<size_t> next_job{ 0 };
+    std::atomic<size_t> loaded{ 0 };
+    std::atomic<size_t> skipped{ 0 };
+    std::atomic<size_t> loaded_bytes{ 0 };
+    // Загруженные файлы вставляются пачкой: одна блокировка, одна копия индекса и одна публикация
+    auto insert_batch = [&](std::vector<std::pair<size_t, FileHandle>>& batch) {
+        if (batch.empty()) {
+            return;
+        }
+        std::lock_guard lock(write_mutex_);
+        auto latest = snapshot();
+        auto files = std::make_shared<CacheIndex>(*latest->files);
+        size_t inserted = 0;
+        for (auto& [job, cached_file] : batch) {
+            const std::string& route = jobs[job].first;
+            if (files->find(route)) {
+                continue;  // Уже загрузил пришедший запрос
+            }
+            if (!fits(*cached_file) || total_cache_size_ + cached_file->memory_size > max_cache_size_) {
+                ++skipped;
+                continue;
+            }
+            loaded_bytes += cached_file->memory_size;
+            cache_insert(*files, route, std::move(cached_file));
+            ++inserted;
+        }
+        if (inserted > 0) {
+            publish(latest->routes, std::move(files));
+            loaded += inserted;
+        }
+        batch.clear();
+    };
+    constexpr size_t batch_files = 64;
+    auto worker = [&]() {
+        std::vector<std::pair<size_t, FileHandle>> batch;
+        batch.reserve(batch_files);
+        for (size_t i = next_job++; i < jobs.size() && !warmup_stop_; i = next_job++) {
+            const auto& route_entry = jobs[i].second;
+            auto cached_file = load_file_from_disk(route_entry->path, route_entry->immutable_fingerprint());
+            if (!cached_file) {
+                continue;
+            }
+            batch.emplace_back(i, std::move(cached_file));
+            if (batch.size() == batch_files) {
+                insert_batch(batch);
+            }
+        }
+        if (!warmup_stop_) {
+            insert_batch(batch);
+        }
+    };
+
+    unsigned threads = warmup_.threads != 0 ? warmup_.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(jobs.size(), 1)));
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    std::cout << "FileCache warm-up: " << loaded << "/" << jobs.size() << " files, " << loaded_bytes << " bytes in "
+        << elapsed.count() << " ms (" << threads << " threads)";
+    if (skipped > 0) {
+        std::cout << ", " << skipped << " skipped: cache budget exhausted";
+    }
+    std::cout << std::endl;
+}
+
 // Перестроение карты файлов (оригинал + лог)
 void FileCache::rebuild_file_map() {
-    std::unique_lock lock(cache_mutex_);
-    route_to_path_.clear();
-    scan_directory(base_directory_);
-    std::cout << "File map rebuilt. Total routes: " << route_to_path_.size()
-        << " in directory: " << base_directory_ << std::endl;
-}
-
-// Получение файла по маршруту (оригинал — это ключевой метод для RequestHandler!)
-std::optional<FileCache::CachedFile> FileCache::get_file(const std::string& route) {
-    std::unique_lock lock(cache_mutex_);
-    // Проверяем, существует ли такой маршрут
-    auto path_it = route_to_path_.find(route);
-    if (path_it == route_to_path_.end()) {
-        return std::nullopt;
+    // Сканирование идёт без блокировок: читатели всё это время обслуживаются из старого снимка
+    auto routes = std::make_shared<RouteMap>();
+    if (source_ == Source::Embedded) {
+        scan_embedded(*routes);
+    }
+    else {
+        scan_directory(base_directory_, *routes);
     }
-    fs::path file_path = path_it->second;
-    // Если кэш отключен, загружаем файл с диска каждый раз
+    const size_t routes_count = routes->size();
+    {
+        std::lock_guard lock(write_mutex_);
+        publish(std::move(routes), snapshot()->files);
+    }
+    std::cout << "File map rebuilt. Total routes: " << routes_count
+        << (source_ == Source::Embedded ? " embedded as: " : " in directory: ") << base_directory_ << std::endl;
+}
+
+// Получение файла по маршруту (ключевой метод для RequestHandler!)
+// Попадание обслуживается по снимку без блокировок, чтение с диска при промахе — тоже
+FileCache::FileHandle FileCache::get_file(const std::string& route) {
+    fs::path file_path;
+    std::string fingerprint;
+    {
+        auto current = snapshot();
+        // Проверяем, существует ли такой маршрут
+        auto path_it = current->routes->find(route);
+        if (path_it == current->routes->end()) {
+            return nullptr;
+        }
+        if (cache_enabled_) {
+            if (const auto* entry = current->files->find(route)) {
+                touch_entry(**entry);
+                return (*entry)->file;
+            }
+        }
+        file_path = path_it->second.path;
+        fingerprint = path_it->second.immutable_fingerprint();
+    }
+    // Загружаем файл с диска (если кэш отключен — каждый раз)
+    auto cached_file = load_file_from_disk(file_path, fingerprint);
+    if (!cached_file || !cache_enabled_) {
+        return cached_file;
+    }
+    return store_loaded_file(route, std::move(cached_file));
+}
+
+FileCache::FileHandle FileCache::find_cached(std::string_view route) {
     if (!cache_enabled_) {
-        return load_file_from_disk(file_path);
+        return nullptr;
     }
-    // Проверяем, есть ли файл в кэше
-    auto cache_it = file_cache_.find(route);
-    if (cache_it != file_cache_.end()) {
-        // Обновляем время доступа
-        cache_it->second.last_accessed = std::chrono::system_clock::now();
-        return cache_it->second;
+    auto current = snapshot();
+    const auto* entry = current->files->find(route);
+    if (!entry) {
+        return nullptr;
     }
-    // Загружаем файл с диска
-    auto cached_file = load_file_from_disk(file_path);
-    if (!cached_file) {
-        return std::nullopt;
+    touch_entry(**entry);
+    return (*entry)->file;
+}
+
+FileCache::FileHandle FileCache::store_loaded_file(const std::string& route, FileHandle cached_file) {
+    std::lock_guard lock(write_mutex_);
+    auto current = snapshot();
+    // Пока читали с диска, файл мог загрузить другой поток
+    if (const auto* entry = current->files->find(route)) {
+        return (*entry)->file;
     }
-    // Проверяем, не переполнен ли кэш
-    evict_if_needed();
-    // Добавляем в кэш
-    file_cache_[route] = *cached_file;
-    total_cache_size_ += cached_file->size;
+    // Добавляем в кэш, вытеснив давно не запрашиваемые файлы (слишком крупные отдаются мимо кэша)
+    if (!fits(*cached_file)) {
+        return cached_file;
+    }
+    auto files = std::make_shared<CacheIndex>(*current->files);
+    cache_insert(*files, route, cached_file);
+    publish(current->routes, std::move(files));
     return cached_file;
 }
 
+bool FileCache::load_file_async(const std::string& route, Post post, AsyncCallback done) {
+    IoUringReader* reader = io_reader_;
+    if (!reader || !reader->available() || source_ == Source::Embedded || !cache_enabled_) {
+        return false;
+    }
+    fs::path file_path;
+    std::string fingerprint;
+    {
+        auto current = snapshot();
+        auto path_it = current->routes->find(route);
+        if (path_it == current->routes->end() || current->files->find(route)) {
+            return false;
+        }
+        // mmap не читает файл целиком — ждать кольца незачем
+        const size_t mmap_threshold = mmap_threshold_;
+        if (mmap_threshold != 0 && path_it->second.size >= mmap_threshold) {
+            return false;
+        }
+        file_path = path_it->second.path;
+        fingerprint = path_it->second.immutable_fingerprint();
+    }
+    {
+        std::lock_guard lock(pending_mutex_);
+        auto [pending_it, first] = pending_loads_.try_emplace(route);
+        pending_it->second.push_back({ post, std::move(done) });
+        if (!first) {
+            return true;  // Файл уже читается по чужому промаху — ответим вместе
+        }
+    }
+    // Готовые копии рядом с файлом читаем той же пачкой, что и сам файл
+    std::vector<fs::path> paths{ file_path };
+    if (compression_enabled_ && compression::is_compressible_mime(get_mime_type(file_path.extension().string()))) {
+        paths.push_back(fs::path(file_path) += ".gz");
+        paths.push_back(fs::path(file_path) += ".br");
+    }
+    const bool started = reader->read_files(std::move(paths),
+        [this, route, file_path, fingerprint, post = std::move(post)](std::vector<IoUringReader::Result> results) {
+            post([this, route, file_path, fingerprint, results = std::move(results)]() mutable {
+                complete_async_load(route, file_path, fingerprint, std::move(results));
+            });
+        });
+    if (!started) {
+        // Кольцо только что остановилось, а ждущие уже записаны — отвечаем им обычной загрузкой
+        complete_async_load(route, file_path, fingerprint, {});
+    }
+    return true;
+}
+
+void FileCache::complete_async_load(const std::string& route, const fs::path& file_path, const std::string& fingerprint,
+    std::vector<IoUringReader::Result> results) {
+    FileHandle file;
+    if (!results.empty() && !results.front().ec) {
+        try {
+            auto cached_file = std::make_shared<CachedFile>();
+            auto& identity = cached_file->representations[static_cast<size_t>(Encoding::Identity)].emplace();
+            identity.storage = std::move(results.front().content);
+            identity.content = identity.storage;
+            file = assemble_cached_file(std::move(cached_file), file_path, results.front().last_modified, nullptr, fingerprint,
+                [&results](const char* suffix) -> std::optional<std::string> {
+                    const size_t index = std::string_view(suffix) == ".gz" ? 1 : 2;
+                    if (index >= results.size() || results[index].ec) {
+                        return std::nullopt;
+                    }
+                    return std::move(results[index].content);
+                });
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error creating cached file for " << file_path << ": " << e.what() << std::endl;
+        }
+    }
+    else {
+        // Кольцо не справилось (остановлено, ошибка ввода-вывода) — файл читается как раньше.
+        // Если его просто нет, load_file_from_disk сразу вернёт nullptr
+        file = load_file_from_disk(file_path, fingerprint);
+    }
+    if (file) {
+        file = store_loaded_file(route, std::move(file));
+    }
+
+    std::vector<PendingWaiter> waiters;
+    {
+        std::lock_guard lock(pending_mutex_);
+        auto node = pending_loads_.extract(route);
+        if (node) {
+            waiters = std::move(node.mapped());
+        }
+    }
+    for (auto& waiter : waiters) {
+        waiter.post([done = std::move(waiter.done), file]() {
+            done(file);
+        });
+    }
+}
+
 // Получение файла по прямому пути (оригинал)
-std::optional<FileCache::CachedFile> FileCache::get_file_by_path(const std::string& file_path) {
+FileCache::FileHandle FileCache::get_file_by_path(const std::string& file_path) {
     fs::path path(file_path);
     if (!path.is_absolute()) {
         path = base_directory_ / path;
     }
-    if (!fs::exists(path) || !fs::is_regular_file(path)) {
-        return std::nullopt;
+    if (source_ == Source::Embedded ? embedded_asset(path) == nullptr : !fs::exists(path) || !fs::is_regular_file(path)) {
+        return nullptr;
     }
     // Создаем временный маршрут для кэширования
     std::string temp_route = "/file" + std::to_string(std::hash<std::string>{}(path.string()));
-    std::unique_lock lock(cache_mutex_);
     if (cache_enabled_) {
-        auto cache_it = file_cache_.find(temp_route);
-        if (cache_it != file_cache_.end()) {
-            cache_it->second.last_accessed = std::chrono::system_clock::now();
-            return cache_it->second;
+        auto current = snapshot();
+        if (const auto* entry = current->files->find(temp_route)) {
+            touch_entry(**entry);
+            return (*entry)->file;
         }
     }
     auto cached_file = load_file_from_disk(path);
     if (!cached_file) {
-        return std::nullopt;
+        return nullptr;
     }
     if (cache_enabled_) {
-        evict_if_needed();
-        file_cache_[temp_route] = *cached_file;
-        total_cache_size_ += cached_file->size;
+        std::lock_guard lock(write_mutex_);  // Лимиты читает cache_insert под этой же блокировкой
+        auto current = snapshot();
+        if (!current->files->find(temp_route)) {
+            auto files = std::make_shared<CacheIndex>(*current->files);
+            cache_insert(*files, temp_route, cached_file);
+            publish(current->routes, std::move(files));
+        }
     }
     return cached_file;
 }
 
 // Принудительное кэширование файла (оригинал)
 bool FileCache::preload_file(const std::string& route) {
-    std::unique_lock lock(cache_mutex_);
-    auto path_it = route_to_path_.find(route);
-    if (path_it == route_to_path_.end()) {
+    auto current = snapshot();
+    auto path_it = current->routes->find(route);
+    if (path_it == current->routes->end()) {
         return false;
     }
-    fs::path file_path = path_it->second;
     // Если файл уже в кэше, просто обновляем время доступа
-    auto cache_it = file_cache_.find(route);
-    if (cache_it != file_cache_.end()) {
-        cache_it->second.last_accessed = std::chrono::system_clock::now();
+    if (const auto* entry = current->files->find(route)) {
+        touch_entry(**entry);
         return true;
     }
     // Загружаем файл
-    auto cached_file = load_file_from_disk(file_path);
+    auto cached_file = load_file_from_disk(path_it->second.path, path_it->second.immutable_fingerprint());
     if (!cached_file) {
         return false;
     }
-    if (cache_enabled_) {
-        evict_if_needed();
-        file_cache_[route] = *cached_file;
-        total_cache_size_ += cached_file->size;
+    if (!cache_enabled_) {
+        return true;
     }
+    std::lock_guard lock(write_mutex_);
+    current = snapshot();
+    auto files = std::make_shared<CacheIndex>(*current->files);
+    if (!cache_insert(*files, route, cached_file)) {
+        return false;
+    }
+    publish(current->routes, std::move(files));
     return true;
 }
 
 // Удаление файла из кэша (оригинал)
 bool FileCache::evict_from_cache(const std::string& route) {
-    std::unique_lock lock(cache_mutex_);
-    auto it = file_cache_.find(route);
-    if (it != file_cache_.end()) {
-        total_cache_size_ -= it->second.size;
-        file_cache_.erase(it);
-        return true;
+    std::lock_guard lock(write_mutex_);
+    auto current = snapshot();
+    if (!current->files->find(route)) {
+        return false;
+    }
+    auto files = std::make_shared<CacheIndex>(*current->files);
+    cache_erase(*files, route);
+    publish(current->routes, std::move(files));
+    return true;
+}
+
+void FileCache::set_fingerprint_assets(bool enabled) {
+    if (fingerprint_assets_.exchange(enabled) == enabled) {
+        return;
     }
-    return false;
+    clear_cache();  // Страницы в кэше собраны со ссылками для прежнего режима
+    rebuild_file_map();
 }
 
 // Очистка всего кэша (оригинал — фиксит ошибку!)
 void FileCache::clear_cache() {
-    std::unique_lock lock(cache_mutex_);
-    file_cache_.clear();
+    std::lock_guard lock(write_mutex_);
+    auto current = snapshot();
+    {
+        std::lock_guard lru_lock(lru_mutex_);
+        current->files->for_each([](const std::string&, const std::shared_ptr<CacheEntry>& entry) {
+            entry->in_lru = false;
+        });
+        lru_.clear();
+    }
     total_cache_size_ = 0;
+    publish(current->routes, std::make_shared<CacheIndex>());
 }
 
 // Получение списка всех маршрутов (оригинал)
 std::vector<std::string> FileCache::get_all_routes() const {
-    std::shared_lock lock(cache_mutex_);
+    auto current = snapshot();
     std::vector<std::string> routes;
-    routes.reserve(route_to_path_.size());
-    for (const auto& pair : route_to_path_) {
+    routes.reserve(current->routes->size());
+    for (const auto& pair : *current->routes) {
         routes.push_back(pair.first);
     }
     return routes;
@@ -388,9 +1185,9 @@ std::vector<std::string> FileCache::get_all_routes() const {
 
 // Поиск маршрутов по шаблону (оригинал)
 std::vector<std::string> FileCache::find_routes(const std::string& pattern) const {
-    std::shared_lock lock(cache_mutex_);
+    auto current = snapshot();
     std::vector<std::string> matches;
-    for (const auto& pair : route_to_path_) {
+    for (const auto& pair : *current->routes) {
         if (pair.first.find(pattern) != std::string::npos) {
             matches.push_back(pair.first);
         }
@@ -400,37 +1197,40 @@ std::vector<std::string> FileCache::find_routes(const std::string& pattern) cons
 
 // Проверка существования маршрута (оригинал)
 bool FileCache::route_exists(const std::string& route) const {
-    std::shared_lock lock(cache_mutex_);
-    return route_to_path_.find(route) != route_to_path_.end();
+    auto current = snapshot();
+    return current->routes->find(route) != current->routes->end();
 }
 
 // Получение информации о кэше (оригинал)
 FileCache::CacheInfo FileCache::get_cache_info() const {
-    std::shared_lock lock(cache_mutex_);
+    std::lock_guard lock(write_mutex_);
+    auto current = snapshot();
     CacheInfo info;
-    info.cached_files_count = file_cache_.size();
-    info.total_routes_count = route_to_path_.size();
+    info.cached_files_count = current->files->size();
+    info.total_routes_count = current->routes->size();
     info.total_cache_size_bytes = total_cache_size_;
     info.max_cache_size = max_cache_size_;
+    info.max_file_size = max_file_size_;
     info.cache_enabled = cache_enabled_;
     return info;
 }
 
 // Получение детальной статистики (оригинал)
 FileCache::CacheStats FileCache::get_detailed_stats() const {
-    std::shared_lock lock(cache_mutex_);
+    std::lock_guard lock(write_mutex_);
+    auto current = snapshot();
     CacheStats stats;
     stats.total_size = total_cache_size_;
-    for (const auto& pair : file_cache_) {
+    current->files->for_each([&](const std::string& route, const std::shared_ptr<CacheEntry>& entry) {
         CacheStats::FileStat file_stat;
-        file_stat.route = pair.first;
-        file_stat.size = pair.second.size;
-        file_stat.last_accessed = pair.second.last_accessed;
-        file_stat.last_modified = pair.second.last_modified;
+        file_stat.route = route;
+        file_stat.size = entry->file->memory_size;
+        file_stat.last_accessed = entry->last_access_time();
+        file_stat.last_modified = entry->file->last_modified;
         stats.files.push_back(file_stat);
-    }
-    if (!file_cache_.empty()) {
-        stats.average_file_size = total_cache_size_ / file_cache_.size();
+    });
+    if (!current->files->empty()) {
+        stats.average_file_size = total_cache_size_ / current->files->size();
     }
     else {
         stats.average_file_size = 0;
@@ -440,36 +1240,39 @@ FileCache::CacheStats FileCache::get_detailed_stats() const {
 
 // Обновление файла в кэше (оригинал)
 bool FileCache::refresh_file(const std::string& route) {
-    std::unique_lock lock(cache_mutex_);
-    auto path_it = route_to_path_.find(route);
-    if (path_it == route_to_path_.end()) {
+    auto current = snapshot();
+    auto path_it = current->routes->find(route);
+    if (path_it == current->routes->end()) {
         return false;
     }
-    fs::path file_path = path_it->second;
+    if (source_ == Source::Embedded) {
+        return preload_file(route);  // Вшитые файлы не меняются
+    }
+    fs::path file_path = path_it->second.path;
     try {
         // Проверяем, изменился ли файл
         auto ftime = fs::last_write_time(file_path);
         auto last_write_time = file_time_to_system_time(ftime);
-        auto cache_it = file_cache_.find(route);
-        if (cache_it != file_cache_.end()) {
+        if (const auto* entry = current->files->find(route)) {
             // Если файл не изменился, просто обновляем время доступа
-            if (last_write_time <= cache_it->second.last_modified) {
-                cache_it->second.last_accessed = std::chrono::system_clock::now();
+            if (last_write_time <= (*entry)->file->last_modified) {
+                touch_entry(**entry);
                 return true;
             }
-            // Удаляем старую версию из кэша
-            total_cache_size_ -= cache_it->second.size;
         }
         // Загружаем новую версию
-        auto cached_file = load_file_from_disk(file_path);
+        auto cached_file = load_file_from_disk(file_path, path_it->second.immutable_fingerprint());
+        std::lock_guard lock(write_mutex_);
+        current = snapshot();
+        auto files = std::make_shared<CacheIndex>(*current->files);
         if (!cached_file) {
-            if (cache_it != file_cache_.end()) {
-                file_cache_.erase(cache_it);
+            if (cache_erase(*files, route)) {
+                publish(current->routes, std::move(files));
             }
             return false;
         }
-        file_cache_[route] = *cached_file;
-        total_cache_size_ += cached_file->size;
+        cache_insert(*files, route, cached_file);
+        publish(current->routes, std::move(files));
         return true;
     }
     catch (const std::exception& e) {
@@ -478,23 +1281,297 @@ bool FileCache::refresh_file(const std::string& route) {
     }
 }
 
+// Файл создан или перезаписан. Маршрут обновляется всегда, а запись кэша перечитывается
+// только если файл уже был в кэше — холодные файлы загрузятся при первом запросе
+void FileCache::on_file_changed(const fs::path& changed_path) {
+    fs::path file_path = changed_path;
+    if (is_precompressed_sibling(file_path)) {
+        file_path.replace_extension();  // Поменялась .gz/.br-копия — перестраиваем представления оригинала
+    }
+    std::string route;
+    RouteEntry route_entry;
+    if (!make_route_entry(file_path, route, route_entry)) {
+        return;
+    }
+    std::vector<std::string> keys{ route };
+    if (route.back() == '/' && route != "/") {
+        keys.push_back(route.substr(0, route.length() - 1));
+    }
+    bool cached = false;
+    {
+        auto current = snapshot();
+        for (const auto& key : keys) {
+            cached = cached || current->files->find(key) != nullptr;
+        }
+    }
+    FileHandle reloaded = cached ? load_file_from_disk(file_path) : nullptr;
+
+    std::lock_guard lock(write_mutex_);
+    auto current = snapshot();
+    auto routes = std::make_shared<RouteMap>(*current->routes);
+    auto files = std::make_shared<CacheIndex>(*current->files);
+    // Хэш поменялся: старый маршрут с хэшем пропадает, страницы со ссылками на него перечитаются
+    auto old_it = current->routes->find(route);
+    const std::string old_fingerprint = old_it != current->routes->end() ? old_it->second.fingerprint : std::string();
+    if (old_fingerprint != route_entry.fingerprint) {
+        if (!old_fingerprint.empty()) {
+            const std::string old_route = fingerprinted_route(route, old_fingerprint);
+            routes->erase(old_route);
+            cache_erase(*files, old_route);
+        }
+        drop_rewritten_pages(*files);
+    }
+    set_route(*routes, route, route_entry);
+    for (const auto& key : keys) {
+        if (!files->find(key)) {
+            continue;
+        }
+        if (reloaded) {
+            cache_insert(*files, key, reloaded);
+        }
+        else {
+            cache_erase(*files, key);
+        }
+    }
+    publish(std::move(routes), std::move(files));
+}
+
+void FileCache::on_file_removed(const fs::path& file_path) {
+    if (is_precompressed_sibling(file_path)) {
+        fs::path original = file_path;
+        on_file_changed(original.replace_extension());
+        return;
+    }
+    std::string route = normalize_route(file_path);
+    std::lock_guard lock(write_mutex_);
+    auto current = snapshot();
+    auto path_it = current->routes->find(route);
+    // В режиме CleanFileType маршрут мог достаться другому файлу с тем же именем
+    if (path_it == current->routes->end() || path_it->second.path != file_path.string()) {
+        return;
+    }
+    const bool had_fingerprint = !path_it->second.fingerprint.empty();
+    auto routes = std::make_shared<RouteMap>(*current->routes);
+    auto files = std::make_shared<CacheIndex>(*current->files);
+    erase_route(*routes, *files, route);
+    if (had_fingerprint) {
+        drop_rewritten_pages(*files);
+    }
+    publish(std::move(routes), std::move(files));
+}
+
+void FileCache::on_directory_added(const fs::path& directory) {
+    RouteMap added;
+    scan_directory(directory, added);
+    std::lock_guard lock(write_mutex_);
+    auto current = snapshot();
+    auto routes = std::make_shared<RouteMap>(*current->routes);
+    bool new_fingerprints = false;
+    for (auto& [route, route_entry] : added) {
+        new_fingerprints = new_fingerprints || !route_entry.fingerprint.empty();
+        (*routes)[route] = std::move(route_entry);
+    }
+    if (!new_fingerprints) {
+        publish(std::move(routes), current->files);
+        return;
+    }
+    auto files = std::make_shared<CacheIndex>(*current->files);
+    drop_rewritten_pages(*files);  // Ссылки на появившиеся ресурсы теперь можно заменить
+    publish(std::move(routes), std::move(files));
+}
+
+void FileCache::on_directory_removed(const fs::path& directory) {
+    std::string prefix = (directory / "").string();
+    std::lock_guard lock(write_mutex_);
+    auto current = snapshot();
+    std::vector<std::string> removed;
+    bool had_fingerprints = false;
+    for (const auto& [route, route_entry] : *current->routes) {
+        if (route_entry.path.compare(0, prefix.size(), prefix) == 0) {
+            removed.push_back(route);
+            had_fingerprints = had_fingerprints || !route_entry.fingerprint.empty();
+        }
+    }
+    if (removed.empty()) {
+        return;
+    }
+    auto routes = std::make_shared<RouteMap>(*current->routes);
+    auto files = std::make_shared<CacheIndex>(*current->files);
+    for (const auto& route : removed) {
+        erase_route(*routes, *files, route);
+    }
+    if (had_fingerprints) {
+        drop_rewritten_pages(*files);
+    }
+    publish(std::move(routes), std::move(files));
+}
+
+void FileCache::sync_with_disk() {
+    if (source_ == Source::Embedded) {
+        return;
+    }
+    auto routes = std::make_shared<RouteMap>();
+    scan_directory(base_directory_, *routes);
+    std::lock_guard lock(write_mutex_);
+    auto current = snapshot();
+    auto files = std::make_shared<CacheIndex>(*current->files);
+    // Изменившиеся и пропавшие файлы выкидываем из кэша — перечитаются при следующем запросе
+    auto stale = files->keys_if([&](const std::string& route, const std::shared_ptr<CacheEntry>&) {
+        auto old_it = current->routes->find(route);
+        auto new_it = routes->find(route);
+        bool unchanged = old_it != current->routes->end() && new_it != routes->end()
+            && old_it->second.path == new_it->second.path
+            && old_it->second.size == new_it->second.size
+            && old_it->second.write_time == new_it->second.write_time;
+        return !unchanged;
+    });
+    for (const auto& route : stale) {
+        cache_erase(*files, route);
+    }
+    // Набор маршрутов с хэшем изменился — ссылки в закэшированных страницах устарели
+    auto fingerprints_differ = [](const RouteMap& lhs, const RouteMap& rhs) {
+        for (const auto& [route, route_entry] : lhs) {
+            if (route_entry.immutable && rhs.find(route) == rhs.end()) {
+                return true;
+            }
+        }
+        return false;
+    };
+    if (fingerprints_differ(*current->routes, *routes) || fingerprints_differ(*routes, *current->routes)) {
+        drop_rewritten_pages(*files);
+    }
+    publish(std::move(routes), std::move(files));
+}
+
+// Большие файлы отдаются потоком (http::file_body / sendfile) и в кэш не попадают
+std::optional<FileCache::StreamedFile> FileCache::get_streamed_file(std::string_view route) const {
+    const size_t threshold = stream_threshold_;
+    if (threshold == 0 || source_ == Source::Embedded) {
+        return std::nullopt;
+    }
+    auto current = snapshot();
+    auto path_it = current->routes->find(route);
+    // Маршрут с хэшем отдаётся из кэша: только там проверяется, что содержимое совпадает с хэшем
+    if (path_it == current->routes->end() || path_it->second.size < threshold || path_it->second.immutable) {
+        return std::nullopt;
+    }
+    fs::path file_path = path_it->second.path;
+    std::string mime_type = get_mime_type(file_path.extension().string());
+    // Текстовые файлы выгоднее отдавать из кэша в сжатом виде, чем несжатыми через sendfile
+    if (compression_enabled_ && compression::is_compressible_mime(mime_type)) {
+        return std::nullopt;
+    }
+    const auto& route_entry = path_it->second;
+    char etag[64];
+    std::snprintf(etag, sizeof(etag), "W/\"%llx-%llx\"", static_cast<unsigned long long>(route_entry.size),
+        static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::seconds>(
+            route_entry.last_modified.time_since_epoch()).count()));
+    return StreamedFile{ file_path, std::move(mime_type), route_entry.size, route_entry.last_modified, etag };
+}
+
+// Название кодировки для Content-Encoding / Accept-Encoding
+const char* FileCache::encoding_name(Encoding encoding) {
+    switch (encoding) {
+    case Encoding::Gzip: return "gzip";
+    case Encoding::Brotli: return "br";
+    default: return "identity";
+    }
+}
+
+// Разбор Accept-Encoding: "gzip, deflate, br;q=0.9, *;q=0". Выбираем доступное
+// представление с наибольшим q, при равенстве — br, затем gzip
+FileCache::Encoding FileCache::negotiate_encoding(std::string_view accept_encoding, const CachedFile& file) {
+    if (!file.vary_encoding || accept_encoding.empty()) {
+        return Encoding::Identity;
+    }
+    double q_values[static_cast<size_t>(Encoding::Count)] = { -1.0, -1.0, -1.0 };
+    double wildcard_q = -1.0;
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string_view::npos) {
+            end = accept_encoding.size();
+        }
+        std::string_view item = accept_encoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        double q = 1.0;
+        size_t semi = item.find(';');
+        std::string_view token = item.substr(0, semi);
+        if (semi != std::string_view::npos) {
+            size_t q_pos = item.find("q=", semi);
+            if (q_pos != std::string_view::npos) {
+                try {
+                    q = std::stod(std::string(item.substr(q_pos + 2)));
+                }
+                catch (const std::exception&) {
+                    q = 0.0;
+                }
+            }
+        }
+        while (!token.empty() && (token.front() == ' ' || token.front() == '\t')) token.remove_prefix(1);
+        while (!token.empty() && (token.back() == ' ' || token.back() == '\t')) token.remove_suffix(1);
+
+        std::string name(token);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name == "br") q_values[static_cast<size_t>(Encoding::Brotli)] = q;
+        else if (name == "gzip" || name == "x-gzip") q_values[static_cast<size_t>(Encoding::Gzip)] = q;
+        else if (name == "*") wildcard_q = q;
+    }
+
+    Encoding best = Encoding::Identity;
+    double best_q = 0.0;
+    for (Encoding candidate : { Encoding::Brotli, Encoding::Gzip }) {
+        if (!file.has(candidate)) {
+            continue;
+        }
+        double q = q_values[static_cast<size_t>(candidate)];
+        if (q < 0.0) {
+            q = wildcard_q;
+        }
+        if (q > best_q) {
+            best = candidate;
+            best_q = q;
+        }
+    }
+    return best;
+}
+
 // Получение MIME типа для маршрута (оригинал)
 std::optional<std::string> FileCache::get_mime_type_for_route(const std::string& route) const {
-    std::shared_lock lock(cache_mutex_);
-    auto path_it = route_to_path_.find(route);
-    if (path_it == route_to_path_.end()) {
+    auto current = snapshot();
+    auto path_it = current->routes->find(route);
+    if (path_it == current->routes->end()) {
         return std::nullopt;
     }
-    fs::path file_path = path_it->second;
+    fs::path file_path = path_it->second.path;
     return get_mime_type(file_path.extension().string());
 }
 
 // Установка максимального размера кэша (оригинал)
 void FileCache::set_max_cache_size(size_t max_size) {
-    std::unique_lock lock(cache_mutex_);
+    std::lock_guard lock(write_mutex_);
     max_cache_size_ = max_size;
     // Если новый размер меньше текущего, вытесняем лишние файлы
-    while (file_cache_.size() > max_cache_size_) {
-        evict_if_needed();
+    auto current = snapshot();
+    auto files = std::make_shared<CacheIndex>(*current->files);
+    evict_if_needed(*files);
+    publish(current->routes, std::move(files));
+}
+
+void FileCache::set_max_file_size(size_t max_size) {
+    std::lock_guard lock(write_mutex_);
+    max_file_size_ = max_size;
+    if (max_file_size_ == 0) {
+        return;
+    }
+    auto current = snapshot();
+    auto files = std::make_shared<CacheIndex>(*current->files);
+    auto oversized = files->keys_if([&](const std::string&, const std::shared_ptr<CacheEntry>& entry) {
+        return entry->file->size > max_file_size_;
+    });
+    for (const auto& route : oversized) {
+        cache_erase(*files, route);
     }
+    publish(current->routes, std::move(files));
 }
\ No newline at end of file
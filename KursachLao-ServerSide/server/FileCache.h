@@ -1,15 +1,24 @@
 ﻿#pragma once
 #include "BaseModule.h"  // Наследование от BaseModule
+#include "EmbeddedStatic.h"
+#include "IoUringReader.h"
+#include "RouteFilter.h"
+#include "ShardedStringMap.h"
+#include "StringHash.h"
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <memory>
 #include <chrono>
-#include <shared_mutex>
 #include <optional>
 #include <vector>
+#include <list>
 #include <functional>
 #include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <thread>
 
 namespace fs = std::filesystem;
 
@@ -17,37 +26,192 @@ class FileCache : public BaseModule {  // UPDATED: Наследник BaseModule
 public:
     enum Mode { None = 0, CleanFileType = 1 };
 
-private:
-    int fileCacheMode;
+    // Откуда берутся файлы: каталог на диске или статика, вшитая в бинарник при сборке
+    // (KURSACH_EMBED_STATIC). Во втором случае base_dir — только префикс путей, диск не читается
+    enum class Source : uint8_t { Disk = 0, Embedded = 1 };
+
+    // Прогрев кэша в onInitialize: файлы загружаются (и сразу сжимаются/хэшируются) параллельно,
+    // пока не кончится бюджет памяти
+    struct WarmupOptions {
+        bool enabled = false;
+        std::string pattern = "*";  // Glob по маршрутам: '*' — любая подстрока (включая '/'), '?' — один символ
+        unsigned threads = 0;       // 0 — по числу ядер
+        bool background = false;    // Не ждать окончания прогрева: onInitialize возвращается сразу
+    };
+
+    // Варианты заранее сериализованного ответа
+    enum class ResponseKind : uint8_t { Ok = 0, NotFound = 1, NotModified = 2, Count };
+
+    // Кодировки, в которых файл может лежать в кэше
+    enum class Encoding : uint8_t { Identity = 0, Gzip = 1, Brotli = 2, Count };
+
+    // Одно представление файла (сырое или сжатое) вместе с готовыми байтами заголовка
+    // HTTP/1.1 для каждого статуса и варианта keep-alive/close. Собирается один раз при загрузке.
+    // content смотрит либо в storage, либо в отображение файла в память (CachedFile::mapping)
+    struct Representation {
+        std::string storage;
+        std::string_view content;
+        std::string etag;  // Сильный ETag (в кавычках): хэш содержимого + суффикс кодировки
+        std::string wire_heads[static_cast<size_t>(ResponseKind::Count)][2];
+
+        const std::string& wire_head(ResponseKind kind, bool keep_alive) const {
+            return wire_heads[static_cast<size_t>(kind)][keep_alive ? 1 : 0];
+        }
+    };
 
+    // Неизменяемая запись кэша. Раздаётся через shared_ptr: попадание в кэш стоит
+    // инкремента счётчика ссылок, а тело ответа ссылается на content без копирования
     struct CachedFile {
-        std::string content;
         std::string mime_type;
         std::chrono::system_clock::time_point last_modified;
-        std::chrono::system_clock::time_point last_accessed;
-        size_t size;
+        size_t size;  // Размер несжатого файла
+        size_t memory_size = 0;  // Сколько запись занимает в куче: представления + готовые заголовки (без mmap)
+        std::shared_ptr<const void> mapping;  // Отображение файла (mmap) для больших файлов — identity читается из него
         fs::path file_path;
+        std::string content_hash;        // Хэш несжатого содержимого (hex), считается один раз при загрузке
+        std::string last_modified_http;  // last_modified в формате HTTP-даты
+        bool vary_encoding = false;  // Есть сжатые варианты — ответы несут Vary: Accept-Encoding
+        bool immutable = false;        // Загружен по маршруту с хэшем содержимого в имени
+        bool links_rewritten = false;  // HTML, в котором ссылки заменены на маршруты с хэшем
+        std::optional<Representation> representations[static_cast<size_t>(Encoding::Count)];  // Identity есть всегда
+
+        bool has(Encoding encoding) const {
+            return representations[static_cast<size_t>(encoding)].has_value();
+        }
+        const Representation& representation(Encoding encoding) const {
+            return *representations[static_cast<size_t>(encoding)];
+        }
+        const Representation& identity() const {
+            return representation(Encoding::Identity);
+        }
+        const char* cache_control() const {
+            return immutable ? "public, max-age=31536000, immutable" : "public, max-age=300";
+        }
+    };
+    using FileHandle = std::shared_ptr<const CachedFile>;
+
+private:
+    int fileCacheMode;
+
+    // Запись кэша: сам файл, позиция в LRU-списке и время последнего доступа (для статистики).
+    // Одна и та же запись живёт в нескольких снимках, поэтому file после создания не меняется,
+    // lru_position/in_lru трогаются только под lru_mutex_, а время — атомарное
+    struct CacheEntry {
+        const FileHandle file;
+        std::list<std::string>::iterator lru_position;
+        bool in_lru = false;
+        std::atomic<std::chrono::system_clock::rep> last_accessed;
+
+        explicit CacheEntry(FileHandle f)
+            : file(std::move(f)), last_accessed(std::chrono::system_clock::now().time_since_epoch().count()) {
+        }
+        void touch() {
+            last_accessed.store(std::chrono::system_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        }
+        std::chrono::system_clock::time_point last_access_time() const {
+            return std::chrono::system_clock::time_point(
+                std::chrono::system_clock::duration(last_accessed.load(std::memory_order_relaxed)));
+        }
+    };
+    using CacheIndex = ShardedStringMap<std::shared_ptr<CacheEntry>>;
+
+    // Путь и размер файла на момент сканирования
+    struct RouteEntry {
+        std::string path;
+        std::uintmax_t size = 0;
+        std::chrono::system_clock::time_point last_modified;
+        fs::file_time_type write_time{};  // Исходное время ФС — для точного сравнения при сверке с диском
+        const embedded_static::Asset* asset = nullptr;  // Source::Embedded: байты файла в бинарнике
+        std::string fingerprint;  // Начало хэша содержимого на момент сканирования (режим fingerprint, не HTML)
+        bool immutable = false;   // Маршрут с fingerprint в имени; у обычного маршрута false
+
+        // Что передать в load_file_from_disk: хэш проверяется только для маршрута с хэшем
+        std::string_view immutable_fingerprint() const {
+            return immutable ? std::string_view(fingerprint) : std::string_view();
+        }
+    };
+    using RouteMap = StringMap<RouteEntry>;
+
+    // Неизменяемый снимок карты маршрутов и индекса кэша. Читатели берут его одной атомарной
+    // загрузкой и дальше работают без блокировок; писатели собирают новый снимок и подменяют его.
+    // Маршруты и индекс — отдельные shared_ptr: загрузка файла копирует только индекс, а копия
+    // индекса делит шарды со старым снимком и дублирует лишь те, что писатель поменял
+    struct Snapshot {
+        std::shared_ptr<const RouteMap> routes;
+        std::shared_ptr<const CacheIndex> files;
+        std::shared_ptr<const RouteFilter> route_filter;  // Пересобирается только вместе с routes
     };
 
     fs::path base_directory_;
-    std::unordered_map<std::string, CachedFile> file_cache_;
-    std::unordered_map<std::string, std::string> route_to_path_;
-    mutable std::shared_mutex cache_mutex_;
-    bool cache_enabled_;
-    size_t max_cache_size_;
-    size_t total_cache_size_;
+    Source source_;
+    std::atomic<std::shared_ptr<const Snapshot>> snapshot_;
+    mutable std::mutex write_mutex_;  // Сериализует писателей (и защищает счётчики размеров); читатели его не берут
+    std::list<std::string> lru_;      // Маршруты в кэше: в начале — недавно запрошенные, в конце — кандидаты на вытеснение
+    std::mutex lru_mutex_;            // Читатели только пробуют его захватить: занят — позиция в LRU не обновится
+    std::atomic<bool> cache_enabled_;
+    std::atomic<bool> compression_enabled_{ true };  // Строить gzip/brotli-варианты текстовых файлов
+    std::atomic<bool> fingerprint_assets_{ false };  // Маршруты с хэшем содержимого и подмена ссылок в HTML
+    size_t max_cache_size_;       // Бюджет памяти кэша в байтах
+    size_t max_file_size_ = 0;    // Файлы крупнее в кэш не кладутся (0 — без ограничения)
+    size_t total_cache_size_;     // Сумма memory_size записей
+    std::atomic<std::uint64_t> generation_{ 0 };  // Растёт с каждым новым снимком
+    std::atomic<size_t> stream_threshold_{ 0 };  // Файлы от этого размера отдаются с диска потоком (0 — выключено)
+    std::atomic<size_t> mmap_threshold_{ 0 };    // Файлы от этого размера отображаются в память, а не читаются в кучу (0 — выключено). С FileWatcher не включать: правка файла на месте даст SIGBUS
+    WarmupOptions warmup_;
+    IoUringReader* io_reader_ = nullptr;  // Чтение при промахе без блокировки потока (nullptr — только синхронно)
+    // Маршруты, которые сейчас читает кольцо, и кто ждёт результата: одновременные промахи
+    // по одному файлу превращаются в одно чтение
+    struct PendingWaiter {
+        std::function<void(std::function<void()>)> post;
+        std::function<void(FileHandle)> done;
+    };
+    std::mutex pending_mutex_;
+    std::unordered_map<std::string, std::vector<PendingWaiter>> pending_loads_;
+    std::thread warmup_thread_;  // Фоновый прогрев (WarmupOptions::background)
+    std::atomic<bool> warmup_stop_{ false };  // Досрочная остановка прогрева при выключении
 
     // Вспомогательные методы (без изменений)
     std::string get_mime_type(const std::string& extension) const;
     std::string normalize_route(const fs::path& file_path) const;
-    std::optional<CachedFile> load_file_from_disk(const fs::path& file_path) const;
-    void evict_if_needed();
-    void scan_directory(const fs::path& directory);
+    std::string route_for_relative(const fs::path& relative_path) const;
+    const embedded_static::Asset* embedded_asset(const fs::path& file_path) const;
+    // fingerprint — маршрут с хэшем: если содержимое ему соответствует, ответ помечается immutable
+    FileHandle load_file_from_disk(const fs::path& file_path, std::string_view fingerprint = {}) const;
+    // Готовая .gz/.br-копия рядом с файлом по суффиксу; nullopt — копии нет
+    using SiblingReader = std::function<std::optional<std::string>(const char* suffix)>;
+    // Всё, что после чтения байтов: identity уже заполнен (куча, mmap или бинарник)
+    FileHandle assemble_cached_file(std::shared_ptr<CachedFile> cached_file, const fs::path& file_path,
+        std::chrono::system_clock::time_point last_modified, const embedded_static::Asset* asset, std::string_view fingerprint,
+        const SiblingReader& read_sibling) const;
+    FileHandle store_loaded_file(const std::string& route, FileHandle cached_file);  // В кэш, если влезает; вернёт актуальную запись
+    void complete_async_load(const std::string& route, const fs::path& file_path, const std::string& fingerprint,
+        std::vector<IoUringReader::Result> results);
+    std::string rewrite_asset_links(std::string_view html, const std::string& page_directory) const;
+    static std::string fingerprinted_route(const std::string& route, std::string_view fingerprint);
+
+    std::shared_ptr<const Snapshot> snapshot() const {
+        return snapshot_.load(std::memory_order_acquire);
+    }
+    void publish(std::shared_ptr<const RouteMap> routes, std::shared_ptr<const CacheIndex> files);
+    // Операции над копией индекса и lru_; вызываются под write_mutex_ (touch_entry — откуда угодно)
+    void evict_if_needed(CacheIndex& files, size_t incoming = 0);
+    bool cache_insert(CacheIndex& files, const std::string& route, FileHandle file);
+    bool cache_erase(CacheIndex& files, const std::string& route);
+    void touch_entry(CacheEntry& entry);
+    bool fits(const CachedFile& file) const;
+    void warm_up();
+    void scan_directory(const fs::path& directory, RouteMap& routes) const;
+    void scan_embedded(RouteMap& routes) const;
+    bool make_route_entry(const fs::path& file_path, std::string& route, RouteEntry& route_entry) const;
+    static void set_route(RouteMap& routes, const std::string& route, const RouteEntry& route_entry);
+    void erase_route(RouteMap& routes, CacheIndex& files, const std::string& route);  // Маршрут, его вариант без слэша и запись кэша
+    void drop_rewritten_pages(CacheIndex& files);  // Ссылки в HTML устарели: хэш одного из файлов поменялся
 
 public:
     // FIXED: Вернул оригинальный конструктор с args (rebuild_file_map() внутри)
-    FileCache(const std::string& base_dir, bool enable_cache = true, size_t max_cache = 100, int chache_mode = Mode::None);
-    ~FileCache() = default;
+    FileCache(const std::string& base_dir, bool enable_cache = true, size_t max_cache_bytes = 64 * 1024 * 1024,
+        size_t max_file_bytes = 0, int chache_mode = Mode::None, Source source = Source::Disk);
+    ~FileCache();
 
     // Запрещаем копирование/перемещение
     FileCache(const FileCache&) = delete;
@@ -61,8 +225,17 @@ public:
 
     // Основной API (без изменений)
     void rebuild_file_map();
-    std::optional<CachedFile> get_file(const std::string& route);
-    std::optional<CachedFile> get_file_by_path(const std::string& file_path);
+    FileHandle get_file(const std::string& route);  // nullptr, если маршрута нет
+    FileHandle find_cached(std::string_view route);  // Только попадание в кэш, диск не трогается
+
+    // Промах без блокировки потока: файл и его .gz/.br читаются через io_uring одной пачкой, запись
+    // собирается (сжатие, хэш) в задаче, переданной в post, — на потоке сессии, а не кольца, — и там же
+    // зовётся done (nullptr — файла уже нет). false — асинхронно не получится (нет кольца или маршрута,
+    // файл под mmap, вшитая статика, кэш выключен): тогда get_file
+    using Post = std::function<void(std::function<void()>)>;
+    using AsyncCallback = std::function<void(FileHandle)>;
+    bool load_file_async(const std::string& route, Post post, AsyncCallback done);
+    FileHandle get_file_by_path(const std::string& file_path);
     bool preload_file(const std::string& route);
     bool evict_from_cache(const std::string& route);
     void clear_cache();
@@ -71,15 +244,45 @@ public:
     std::vector<std::string> get_all_routes() const;
     std::vector<std::string> find_routes(const std::string& pattern) const;
     bool route_exists(const std::string& route) const;
+    // Быстрая проверка по фильтру Блума: false — маршрута точно нет, true — скорее всего есть
+    bool may_have_route(std::string_view route) const {
+        return snapshot()->route_filter->may_contain(route);
+    }
+    // Номер текущего снимка: пока он не изменился, полученные FileHandle актуальны.
+    // Позволяет держать у себя часто нужный файл (страницу 404), не обращаясь к кэшу на каждый запрос
+    std::uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
     std::optional<std::string> get_mime_type_for_route(const std::string& route) const;
     bool refresh_file(const std::string& route);
 
+    // Уведомления об изменениях в base_directory_ (их шлёт FileWatcher). Запрос к кэшу
+    // после этого не трогает файловую систему: маршруты и записи уже актуальны
+    void on_file_changed(const fs::path& file_path);
+    void on_file_removed(const fs::path& file_path);
+    void on_directory_added(const fs::path& directory);
+    void on_directory_removed(const fs::path& directory);
+    void sync_with_disk();  // Полная сверка с диском — для опроса без inotify и после переполнения очереди событий
+
+    // Выбор лучшего представления по заголовку Accept-Encoding (br > gzip > identity)
+    static Encoding negotiate_encoding(std::string_view accept_encoding, const CachedFile& file);
+    static const char* encoding_name(Encoding encoding);
+
+    // Файл, который отдаётся потоком с диска (http::file_body, sendfile на Linux)
+    struct StreamedFile {
+        fs::path file_path;
+        std::string mime_type;
+        std::uintmax_t size;
+        std::chrono::system_clock::time_point last_modified;
+        std::string etag;  // Слабый ETag из размера и времени изменения — содержимое не читаем
+    };
+    std::optional<StreamedFile> get_streamed_file(std::string_view route) const;
+
     // Структуры для статистики (без изменений)
     struct CacheInfo {
         size_t cached_files_count;
         size_t total_routes_count;
         size_t total_cache_size_bytes;
-        size_t max_cache_size;
+        size_t max_cache_size;  // Байты
+        size_t max_file_size;
         bool cache_enabled;
     };
     struct CacheStats {
@@ -100,8 +303,29 @@ public:
 
     // Геттеры/сеттеры (без изменений)
     std::string get_base_directory() const { return base_directory_.string(); }
+    bool is_embedded() const { return source_ == Source::Embedded; }
     bool is_cache_enabled() const { return cache_enabled_; }
     void set_cache_enabled(bool enabled) { cache_enabled_ = enabled; }
-    size_t get_max_cache_size() const { return max_cache_size_; }
+    bool is_compression_enabled() const { return compression_enabled_; }
+    void set_compression_enabled(bool enabled) { compression_enabled_ = enabled; }
+    // Для не-HTML файлов публикуются маршруты вида /modules/dataCache.<hash>.js (Cache-Control: immutable),
+    // а src/href в HTML при загрузке подменяются на них. Включение пересобирает карту маршрутов
+    bool is_fingerprint_assets() const { return fingerprint_assets_; }
+    void set_fingerprint_assets(bool enabled);
+    size_t get_max_cache_size() const {
+        std::lock_guard lock(write_mutex_);
+        return max_cache_size_;
+    }
     void set_max_cache_size(size_t max_size);
+    size_t get_max_file_size() const {
+        std::lock_guard lock(write_mutex_);
+        return max_file_size_;
+    }
+    void set_max_file_size(size_t max_size);
+    size_t get_stream_threshold() const { return stream_threshold_; }
+    void set_stream_threshold(size_t threshold) { stream_threshold_ = threshold; }
+    size_t get_mmap_threshold() const { return mmap_threshold_; }
+    void set_mmap_threshold(size_t threshold) { mmap_threshold_ = threshold; }
+    void set_warmup(const WarmupOptions& options) { warmup_ = options; }  // До initialize()
+    void set_io_reader(IoUringReader* reader) { io_reader_ = reader; }  // До запуска воркеров
 };
\ No newline at end of file
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/optional.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+
+// Тело ответа — отрезок файла [offset, offset + length). Используется для 206 Partial Content
+// по большим файлам, которые не лежат в кэше. На Linux LambdaSenders отправляет его через
+// sendfile со смещением, на остальных платформах writer читает отрезок кусками.
+struct file_range_body {
+    class value_type {
+        beast::file file_;
+        std::uint64_t offset_ = 0;
+        std::uint64_t length_ = 0;
+
+        friend struct file_range_body;
+
+    public:
+        void open(const char* path, std::uint64_t offset, std::uint64_t length, beast::error_code& ec) {
+            file_.open(path, beast::file_mode::read, ec);
+            offset_ = offset;
+            length_ = length;
+        }
+
+        beast::file& file() { return file_; }
+        std::uint64_t offset() const { return offset_; }
+        std::uint64_t length() const { return length_; }
+    };
+
+    static std::uint64_t size(const value_type& body) {
+        return body.length_;
+    }
+
+    class writer {
+        value_type& body_;
+        std::uint64_t remain_ = 0;
+        char buf_[4096];  // Столько же читает за раз http::file_body
+
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template<bool isRequest, class Fields>
+        writer(http::header<isRequest, Fields>&, value_type& body)
+            : body_(body) {
+        }
+
+        void init(beast::error_code& ec) {
+            remain_ = body_.length_;
+            body_.file_.seek(body_.offset_, ec);
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            std::size_t amount = static_cast<std::size_t>(
+                std::min<std::uint64_t>(remain_, sizeof(buf_)));
+            if (amount == 0) {
+                ec = {};
+                return boost::none;
+            }
+            std::size_t nread = body_.file_.read(buf_, amount, ec);
+            if (ec) {
+                return boost::none;
+            }
+            if (nread == 0) {
+                ec = http::error::short_read;
+                return boost::none;
+            }
+            remain_ -= nread;
+            return { { const_buffers_type(buf_, nread), remain_ > 0 } };
+        }
+    };
+};
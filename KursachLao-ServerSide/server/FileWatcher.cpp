@@ -0,0 +1,189 @@
+﻿#include "FileWatcher.h"
+#include <iostream>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+FileWatcher::FileWatcher(FileCache* cache, std::chrono::milliseconds poll_interval)
+    : BaseModule("File Watcher"), cache_(cache), base_directory_(cache->get_base_directory()), poll_interval_(poll_interval) {
+}
+
+FileWatcher::~FileWatcher() {
+    stop();
+}
+
+bool FileWatcher::onInitialize() {
+    running_ = true;
+#ifdef __linux__
+    if (startInotify()) {
+        thread_ = std::thread(&FileWatcher::inotifyLoop, this);
+        std::cout << "FileWatcher: inotify on " << base_directory_ << " (" << watch_dirs_.size() << " directories)" << std::endl;
+        return true;
+    }
+    std::cerr << "FileWatcher: inotify unavailable, falling back to polling" << std::endl;
+#endif
+    thread_ = std::thread(&FileWatcher::pollLoop, this);
+    std::cout << "FileWatcher: polling " << base_directory_ << " every " << poll_interval_.count() << " ms" << std::endl;
+    return true;
+}
+
+void FileWatcher::onShutdown() {
+    stop();
+    std::cout << "FileWatcher shutdown" << std::endl;
+}
+
+void FileWatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        running_ = false;
+    }
+    stop_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+#ifdef __linux__
+    if (inotify_fd_ >= 0) {
+        ::close(inotify_fd_);
+        inotify_fd_ = -1;
+        watch_dirs_.clear();
+    }
+#endif
+}
+
+// Запасной вариант без уведомлений ОС: раз в poll_interval_ сверяем кэш с диском
+void FileWatcher::pollLoop() {
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+    while (running_) {
+        stop_cv_.wait_for(lock, poll_interval_, [this] { return !running_; });
+        if (!running_) {
+            break;
+        }
+        lock.unlock();
+        cache_->sync_with_disk();
+        lock.lock();
+    }
+}
+
+#ifdef __linux__
+namespace {
+    // Создание/запись/переименование/удаление внутри каталога. Изменения ловим по IN_CLOSE_WRITE,
+    // а не IN_MODIFY, чтобы не перечитывать файл, который ещё дописывается
+    constexpr uint32_t watch_mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+}
+
+bool FileWatcher::startInotify() {
+    inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        return false;
+    }
+    addWatchRecursive(base_directory_);
+    if (watch_dirs_.empty()) {
+        ::close(inotify_fd_);
+        inotify_fd_ = -1;
+        return false;
+    }
+    return true;
+}
+
+void FileWatcher::addWatchRecursive(const fs::path& directory) {
+    int wd = ::inotify_add_watch(inotify_fd_, directory.c_str(), watch_mask);
+    if (wd < 0) {
+        std::cerr << "FileWatcher: cannot watch " << directory << ": " << std::strerror(errno) << std::endl;
+        return;
+    }
+    watch_dirs_[wd] = directory;
+    std::error_code ec;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code type_ec;
+        if (it->is_directory(type_ec) && !it->is_symlink(type_ec)) {
+            addWatchRecursive(it->path());
+        }
+    }
+}
+
+// Каталог переехал за пределы base_directory_: его watch-и продолжили бы слать события со старыми путями
+void FileWatcher::removeWatchesUnder(const fs::path& directory) {
+    std::string prefix = (directory / "").string();
+    for (auto it = watch_dirs_.begin(); it != watch_dirs_.end();) {
+        const std::string path = it->second.string();
+        if (it->second == directory || path.compare(0, prefix.size(), prefix) == 0) {
+            ::inotify_rm_watch(inotify_fd_, it->first);
+            it = watch_dirs_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void FileWatcher::inotifyLoop() {
+    alignas(inotify_event) char buffer[16 * 1024];
+    pollfd pfd{ inotify_fd_, POLLIN, 0 };
+    while (running_) {
+        // Таймаут — чтобы заметить остановку модуля
+        int ready = ::poll(&pfd, 1, 500);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "FileWatcher: poll failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        for (;;) {
+            ssize_t length = ::read(inotify_fd_, buffer, sizeof(buffer));
+            if (length <= 0) {
+                break;  // EAGAIN — очередь событий разобрана
+            }
+            handleEvents(buffer, static_cast<std::size_t>(length));
+        }
+    }
+}
+
+void FileWatcher::handleEvents(const char* buffer, std::size_t length) {
+    for (std::size_t offset = 0; offset < length;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            // События потеряны — восстанавливаем состояние полной сверкой
+            std::cerr << "FileWatcher: event queue overflow, resyncing cache" << std::endl;
+            cache_->sync_with_disk();
+            continue;
+        }
+        if (event->mask & IN_IGNORED) {
+            watch_dirs_.erase(event->wd);  // Каталог удалён, ядро само сняло watch
+            continue;
+        }
+        auto dir_it = watch_dirs_.find(event->wd);
+        if (dir_it == watch_dirs_.end() || event->len == 0) {
+            continue;
+        }
+        const fs::path path = dir_it->second / event->name;
+
+        if (event->mask & IN_ISDIR) {
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                // Сначала watch, потом скан: файлы, появившиеся между ними, придут событиями
+                addWatchRecursive(path);
+                cache_->on_directory_added(path);
+            }
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                removeWatchesUnder(path);
+                cache_->on_directory_removed(path);
+            }
+            continue;
+        }
+        if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+            cache_->on_file_changed(path);
+        }
+        else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            cache_->on_file_removed(path);
+        }
+    }
+}
+#endif
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include "BaseModule.h"
+#include "FileCache.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+// Фоновое слежение за base_directory_ FileCache. На Linux — inotify: изменённые файлы
+// перечитываются, новые и удалённые добавляют/убирают маршруты. На других платформах
+// (или если inotify недоступен) — периодическая сверка с диском через sync_with_disk().
+// Благодаря этому обработка запроса к статике не делает ни одного системного вызова к ФС.
+class FileWatcher : public BaseModule {
+public:
+    explicit FileWatcher(FileCache* cache, std::chrono::milliseconds poll_interval = std::chrono::seconds(2));
+    ~FileWatcher();
+
+protected:
+    bool onInitialize() override;
+    void onShutdown() override;
+
+private:
+    void stop();
+    void pollLoop();
+
+#ifdef __linux__
+    bool startInotify();
+    void inotifyLoop();
+    void addWatchRecursive(const fs::path& directory);
+    void removeWatchesUnder(const fs::path& directory);
+    void handleEvents(const char* buffer, std::size_t length);
+
+    int inotify_fd_ = -1;
+    std::unordered_map<int, fs::path> watch_dirs_;  // wd -> каталог
+#endif
+
+    FileCache* cache_;
+    fs::path base_directory_;
+    std::chrono::milliseconds poll_interval_;
+    std::thread thread_;
+    std::atomic<bool> running_{ false };
+    std::mutex stop_mutex_;
+    std::condition_variable stop_cv_;
+};
@@ -0,0 +1,560 @@
+﻿#include "IoUringReader.h"
+#include <algorithm>
+#include <iostream>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define KURSACH_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+// Чтение одного файла: statx и openat уходят в ядро связкой, затем read (один или несколько, если
+// ядро вернуло меньше запрошенного). Адрес структуры — user_data операций, поэтому Batch::files
+// после создания не перераспределяется
+struct IoUringReader::FileRead {
+    Batch* batch = nullptr;
+    std::size_t index = 0;
+    std::string path;  // Ядро читает путь при отправке statx/openat — строка должна жить до их завершения
+#ifdef KURSACH_IO_URING
+    struct statx stx {};
+#endif
+    int fd = -1;
+    int statx_result = 0;
+    int open_result = 0;
+    int pending = 0;  // Сколько из statx/openat ещё не завершилось
+    std::size_t size = 0;
+    std::size_t offset = 0;
+};
+
+struct IoUringReader::Batch {
+    std::vector<FileRead> files;
+    std::vector<Result> results;
+    std::size_t remaining = 0;
+    Callback callback;
+};
+
+#ifdef KURSACH_IO_URING
+namespace {
+    // В младших битах user_data — вид операции: FileRead выровнен минимум на 8
+    enum Op : std::uint64_t { op_wake = 0, op_statx = 1, op_open = 2, op_read = 3 };
+    constexpr std::uint64_t op_mask = 7;
+
+    // len в SQE 32-битный — большие файлы читаются частями
+    constexpr std::size_t max_read_chunk = std::size_t{ 1 } << 30;
+
+    int sys_io_uring_setup(unsigned entries, io_uring_params* params) {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+        return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+    }
+
+    std::error_code errno_code(int error) {
+        return std::error_code(error, std::generic_category());
+    }
+}
+
+// Кольцо в памяти, общей с ядром: SQ (заявки), CQ (завершения) и массив SQE.
+// Трогает его только поток кольца, поэтому синхронизация — лишь барьеры на head/tail
+struct IoUringReader::Ring {
+    int fd = -1;
+    int wake_fd = -1;  // eventfd: потоки сервера будят поток кольца, ждущего в io_uring_enter
+
+    void* sq_ptr = MAP_FAILED;
+    std::size_t sq_size = 0;
+    void* cq_ptr = MAP_FAILED;
+    std::size_t cq_size = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t sqes_size = 0;
+
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned cq_mask = 0;
+    unsigned cq_entries = 0;
+
+    unsigned local_tail = 0;  // Заполненные, но ещё не опубликованные SQE
+    unsigned to_submit = 0;
+
+    ~Ring() {
+        close();
+        if (wake_fd >= 0) {
+            ::close(wake_fd);
+        }
+    }
+
+    // Закрытие кольца: ядро отменяет и дожидается своих заявок само. wake_fd остаётся открытым
+    // до деструктора — в него ещё может писать read_files, успевший пройти проверку running_
+    void close() {
+        if (sqes != MAP_FAILED) {
+            ::munmap(sqes, sqes_size);
+            sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        }
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+            ::munmap(cq_ptr, cq_size);
+        }
+        cq_ptr = MAP_FAILED;
+        if (sq_ptr != MAP_FAILED) {
+            ::munmap(sq_ptr, sq_size);
+            sq_ptr = MAP_FAILED;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool open(unsigned entries, std::string& error) {
+        io_uring_params params{};
+        fd = sys_io_uring_setup(entries, &params);
+        if (fd < 0) {
+            error = std::string("io_uring_setup: ") + std::strerror(errno);
+            return false;
+        }
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            sq_size = cq_size = std::max(sq_size, cq_size);
+        }
+        sq_ptr = ::mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) {
+            error = std::string("mmap SQ ring: ") + std::strerror(errno);
+            return false;
+        }
+        cq_ptr = single_mmap ? sq_ptr
+            : ::mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) {
+            error = std::string("mmap CQ ring: ") + std::strerror(errno);
+            return false;
+        }
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            error = std::string("mmap SQEs: ") + std::strerror(errno);
+            return false;
+        }
+
+        auto* sq = static_cast<char*>(sq_ptr);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sq_entries = params.sq_entries;
+        auto* cq = static_cast<char*>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        cq_entries = params.cq_entries;
+        local_tail = *sq_tail;
+
+        // Ядро может знать io_uring, но не нужные операции (5.1–5.5) — проверяем заранее
+        constexpr unsigned probe_ops = 256;
+        std::vector<char> probe_buffer(sizeof(io_uring_probe) + probe_ops * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(probe_buffer.data());
+        if (sys_io_uring_register(fd, IORING_REGISTER_PROBE, probe, probe_ops) < 0) {
+            error = std::string("io_uring probe: ") + std::strerror(errno);
+            return false;
+        }
+        for (unsigned op : { IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_POLL_ADD }) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                error = "io_uring opcode " + std::to_string(op) + " is not supported by the kernel";
+                return false;
+            }
+        }
+
+        wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd < 0) {
+            error = std::string("eventfd: ") + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    // Свободное место под count заявок: при заполненной SQ накопленное сначала уходит в ядро
+    void reserve(unsigned count) {
+        while (sq_entries - (local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE)) < count) {
+            enter(0);
+        }
+    }
+
+    // Только после reserve()
+    io_uring_sqe* get_sqe() {
+        const unsigned index = local_tail & sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+        ++local_tail;
+        ++to_submit;
+        return sqe;
+    }
+
+    // Отправка всех накопленных SQE и, если min_complete > 0, ожидание завершений — один системный вызов
+    int enter(unsigned min_complete) {
+        __atomic_store_n(sq_tail, local_tail, __ATOMIC_RELEASE);
+        const int submitted = sys_io_uring_enter(fd, to_submit, min_complete, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (submitted < 0) {
+            return -errno;
+        }
+        to_submit -= static_cast<unsigned>(submitted);
+        return submitted;
+    }
+
+    template<class Handler>
+    void reap(Handler&& handler) {
+        unsigned head = *cq_head;
+        const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & cq_mask];
+            handler(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+};
+#else
+struct IoUringReader::Ring {};
+#endif
+
+IoUringReader::IoUringReader(unsigned queue_depth)
+    : BaseModule("io_uring File Reader"), queue_depth_(queue_depth) {
+}
+
+IoUringReader::~IoUringReader() {
+    stop();
+}
+
+bool IoUringReader::onInitialize() {
+#ifdef KURSACH_IO_URING
+    auto ring = std::make_unique<Ring>();
+    std::string error;
+    if (!ring->open(queue_depth_, error)) {
+        // Не ошибка модуля: FileCache просто продолжит читать файлы сам
+        std::cerr << "IoUringReader: " << error << ", falling back to blocking reads" << std::endl;
+        return true;
+    }
+    ring_ = std::move(ring);
+    running_ = true;
+    thread_ = std::thread(&IoUringReader::run, this);
+    std::cout << "IoUringReader: " << ring_->sq_entries << " SQ / " << ring_->cq_entries << " CQ entries" << std::endl;
+#else
+    std::cerr << "IoUringReader: io_uring is not available on this platform, falling back to blocking reads" << std::endl;
+#endif
+    return true;
+}
+
+void IoUringReader::onShutdown() {
+    stop();
+    std::cout << "IoUringReader shutdown" << std::endl;
+}
+
+void IoUringReader::stop() {
+    // Флаг и очередь — под одной блокировкой: read_files, проверивший running_ до остановки,
+    // успеет положить пачку раньше, чем её заберут сюда, а после — получит false
+    std::vector<std::unique_ptr<Batch>> abandoned;
+    bool was_running;
+    {
+        std::lock_guard lock(queue_mutex_);
+        was_running = running_.exchange(false);
+        abandoned.swap(queue_);
+    }
+#ifdef KURSACH_IO_URING
+    if (was_running && ring_) {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] auto written = ::write(ring_->wake_fd, &one, sizeof(one));
+    }
+#else
+    (void)was_running;
+#endif
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    // Пачки, которые не успели уйти в ядро, — с ошибкой: ждущие их запросы должны получить ответ
+    fail_batches(abandoned, std::errc::operation_canceled);
+}
+
+void IoUringReader::fail_batches(std::vector<std::unique_ptr<Batch>>& batches, std::errc error) {
+    for (auto& batch : batches) {
+        for (auto& result : batch->results) {
+            result.ec = std::make_error_code(error);
+        }
+        batch->callback(std::move(batch->results));
+    }
+    batches.clear();
+}
+
+bool IoUringReader::read_files(std::vector<fs::path> paths, Callback callback) {
+    if (!running_ || paths.empty()) {
+        return false;  // Быстрый отказ без сборки пачки; окончательная проверка — под блокировкой
+    }
+    auto batch = std::make_unique<Batch>();
+    batch->files.resize(paths.size());
+    batch->results.resize(paths.size());
+    batch->remaining = paths.size();
+    batch->callback = std::move(callback);
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        batch->files[i].batch = batch.get();
+        batch->files[i].index = i;
+        batch->files[i].path = paths[i].string();
+    }
+    bool was_empty;
+    {
+        std::lock_guard lock(queue_mutex_);
+        if (!running_) {
+            return false;  // stop() уже забрал очередь — пачку никто не обработал бы
+        }
+        was_empty = queue_.empty();
+        queue_.push_back(std::move(batch));
+    }
+#ifdef KURSACH_IO_URING
+    // Непустую очередь поток кольца и так заберёт — будим его только первой заявкой
+    if (was_empty) {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] auto written = ::write(ring_->wake_fd, &one, sizeof(one));
+    }
+#else
+    (void)was_empty;
+#endif
+    return true;
+}
+
+#ifdef KURSACH_IO_URING
+void IoUringReader::run() {
+    Ring& ring = *ring_;
+    auto arm_wake = [&]() {
+        ring.reserve(1);
+        io_uring_sqe* sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = ring.wake_fd;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = op_wake;
+    };
+
+    arm_wake();
+    bool stopping = false;
+    std::vector<std::unique_ptr<Batch>> batches;
+    while (!stopping || in_flight_ops_ > 0) {
+        if (!stopping) {
+            // Столько пачек, сколько влезет в CQ: иначе завершения копились бы в ядре сверх кольца
+            std::lock_guard lock(queue_mutex_);
+            std::size_t taken = 0;
+            std::size_t ops = in_flight_ops_;
+            for (; taken < queue_.size(); ++taken) {
+                const std::size_t batch_ops = queue_[taken]->files.size() * 2;
+                if (ops > 0 && ops + batch_ops >= ring.cq_entries) {
+                    break;
+                }
+                ops += batch_ops;
+            }
+            batches.assign(std::make_move_iterator(queue_.begin()), std::make_move_iterator(queue_.begin() + taken));
+            queue_.erase(queue_.begin(), queue_.begin() + taken);
+        }
+        start_batches(batches);
+        batches.clear();
+
+        // Заявки всех пачек и ожидание хотя бы одного завершения — один вызов
+        const int entered = ring.enter(1);
+        if (entered < 0 && entered != -EINTR && entered != -EAGAIN && entered != -EBUSY) {
+            std::cerr << "IoUringReader: io_uring_enter: " << std::strerror(-entered) << std::endl;
+            break;
+        }
+        ring.reap([&](std::uint64_t user_data, int result) {
+            if ((user_data & op_mask) != op_wake) {
+                handle_completion(user_data, result);
+                return;
+            }
+            std::uint64_t value;
+            while (::read(ring.wake_fd, &value, sizeof(value)) > 0) {
+            }
+            if (running_) {
+                arm_wake();
+            }
+            else {
+                stopping = true;
+            }
+        });
+    }
+    // Кольцо сломалось посреди работы — новые пачки не принимаем (available() == false, FileCache
+    // снова читает сам), а ждущие и незавершённые закрываем с ошибкой
+    std::vector<std::unique_ptr<Batch>> queued;
+    {
+        std::lock_guard lock(queue_mutex_);
+        running_ = false;
+        queued.swap(queue_);
+    }
+    fail_batches(queued, std::errc::io_error);
+    // Заявки в ядре ещё пишут в буферы in_flight_: сначала закрываем кольцо, чтобы ядро их
+    // отменило, и только потом освобождаем пачки
+    ring.close();
+    for (auto& [pointer, batch] : in_flight_) {
+        for (auto& file : batch->files) {
+            if (file.fd >= 0) {
+                ::close(file.fd);
+            }
+        }
+        for (auto& result : batch->results) {
+            result.ec = std::make_error_code(std::errc::io_error);
+            result.content.clear();
+        }
+        batch->callback(std::move(batch->results));
+    }
+    in_flight_.clear();
+}
+
+void IoUringReader::start_batches(std::vector<std::unique_ptr<Batch>>& batches) {
+    for (auto& batch : batches) {
+        for (auto& file : batch->files) {
+            // statx по пути и openat связаны: при ошибке statx ядро отменит openat (-ECANCELED).
+            // Связка не должна разорваться между двумя вызовами — место сразу под обе заявки
+            ring_->reserve(2);
+            io_uring_sqe* sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_STATX;
+            sqe->flags = IOSQE_IO_LINK;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<std::uint64_t>(file.path.c_str());
+            sqe->len = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+            sqe->off = reinterpret_cast<std::uint64_t>(&file.stx);
+            sqe->user_data = reinterpret_cast<std::uint64_t>(&file) | op_statx;
+
+            sqe = ring_->get_sqe();
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<std::uint64_t>(file.path.c_str());
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = reinterpret_cast<std::uint64_t>(&file) | op_open;
+
+            file.pending = 2;
+            in_flight_ops_ += 2;
+        }
+        Batch* key = batch.get();
+        in_flight_.emplace(key, std::move(batch));
+    }
+}
+
+void IoUringReader::handle_completion(std::uint64_t user_data, int result) {
+    --in_flight_ops_;
+    auto& file = *reinterpret_cast<FileRead*>(user_data & ~op_mask);
+    const auto op = user_data & op_mask;
+    if (op == op_read) {
+        if (result == -EINTR || result == -EAGAIN) {
+            submit_read(file);
+            return;
+        }
+        if (result < 0) {
+            finish_file(file, errno_code(-result));
+            return;
+        }
+        file.offset += static_cast<std::size_t>(result);
+        if (result == 0) {
+            // Файл укоротили после statx — отдаём то, что успели прочитать
+            file.batch->results[file.index].content.resize(file.offset);
+            finish_file(file, {});
+        }
+        else if (file.offset < file.size) {
+            submit_read(file);
+        }
+        else {
+            finish_file(file, {});
+        }
+        return;
+    }
+
+    if (op == op_statx) {
+        file.statx_result = result;
+    }
+    else {
+        file.open_result = result;
+        if (result >= 0) {
+            file.fd = result;
+        }
+    }
+    if (--file.pending > 0) {
+        return;
+    }
+    if (file.statx_result < 0) {
+        finish_file(file, errno_code(-file.statx_result));
+        return;
+    }
+    if (file.open_result < 0) {
+        finish_file(file, errno_code(-file.open_result));
+        return;
+    }
+    if (!S_ISREG(file.stx.stx_mode)) {
+        finish_file(file, std::make_error_code(std::errc::is_a_directory));
+        return;
+    }
+    // statx и openat шли по пути, а не по дескриптору, поэтому при подмене файла между ними
+    // размер может не совпасть с открытым inode. Не страшно: read упрётся в конец файла,
+    // а FileWatcher всё равно перечитает изменённый файл
+    auto& result_entry = file.batch->results[file.index];
+    result_entry.last_modified = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::seconds(file.stx.stx_mtime.tv_sec) + std::chrono::nanoseconds(file.stx.stx_mtime.tv_nsec)));
+    file.size = static_cast<std::size_t>(file.stx.stx_size);
+    result_entry.content.resize(file.size);
+    if (file.size == 0) {
+        finish_file(file, {});
+        return;
+    }
+    submit_read(file);
+}
+
+void IoUringReader::submit_read(FileRead& file) {
+    ring_->reserve(1);
+    io_uring_sqe* sqe = ring_->get_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = file.fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(file.batch->results[file.index].content.data() + file.offset);
+    sqe->len = static_cast<std::uint32_t>(std::min(file.size - file.offset, max_read_chunk));
+    sqe->off = file.offset;
+    sqe->user_data = reinterpret_cast<std::uint64_t>(&file) | op_read;
+    ++in_flight_ops_;
+}
+
+void IoUringReader::finish_file(FileRead& file, std::error_code ec) {
+    if (file.fd >= 0) {
+        ::close(file.fd);
+        file.fd = -1;
+    }
+    Batch* batch = file.batch;
+    if (ec) {
+        batch->results[file.index].ec = ec;
+        batch->results[file.index].content.clear();
+    }
+    if (--batch->remaining > 0) {
+        return;
+    }
+    // file принадлежит пачке — после этой строки его больше не трогаем
+    auto node = in_flight_.extract(batch);
+    try {
+        node.mapped()->callback(std::move(batch->results));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "IoUringReader: callback error: " << e.what() << std::endl;
+    }
+}
+#else
+void IoUringReader::run() {}
+void IoUringReader::start_batches(std::vector<std::unique_ptr<Batch>>&) {}
+void IoUringReader::handle_completion(std::uint64_t, int) {}
+void IoUringReader::submit_read(FileRead&) {}
+void IoUringReader::finish_file(FileRead&, std::error_code) {}
+#endif
@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include "BaseModule.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Чтение файлов через io_uring (Linux 5.6+). Кольцо заводится системными вызовами напрямую,
+// liburing не нужен. Запросы из всех потоков копятся в очереди, поток кольца забирает их
+// пачкой: statx/openat/read всех файлов пачки уходят в ядро одним io_uring_enter.
+// Потоки сервера на диск не ждут — результат приходит в колбек на потоке кольца.
+// Без io_uring (не Linux, старое ядро, seccomp) available() == false, и FileCache читает сам
+class IoUringReader : public BaseModule {
+public:
+    struct Result {
+        std::error_code ec;  // no_such_file_or_directory для .gz/.br-копий — обычное дело
+        std::string content;
+        std::chrono::system_clock::time_point last_modified;
+    };
+    // Один вызов на пачку, результаты в порядке путей. Вызывается на потоке кольца:
+    // тяжёлую работу колбек переносит на свои потоки
+    using Callback = std::function<void(std::vector<Result>)>;
+
+    explicit IoUringReader(unsigned queue_depth = 256);
+    ~IoUringReader();
+
+    bool available() const { return running_; }
+    // false — кольцо не работает, колбек не будет вызван
+    bool read_files(std::vector<fs::path> paths, Callback callback);
+
+protected:
+    bool onInitialize() override;
+    void onShutdown() override;
+
+private:
+    struct Batch;
+    struct FileRead;
+    struct Ring;
+
+    void stop();
+    void run();
+    void start_batches(std::vector<std::unique_ptr<Batch>>& batches);
+    void handle_completion(std::uint64_t user_data, int result);
+    void submit_read(FileRead& file);
+    void finish_file(FileRead& file, std::error_code ec);
+    // Колбеки пачек, так и не ушедших в ядро, — с ошибкой error
+    static void fail_batches(std::vector<std::unique_ptr<Batch>>& batches, std::errc error);
+
+    unsigned queue_depth_;
+    std::unique_ptr<Ring> ring_;
+    std::thread thread_;
+    std::atomic<bool> running_{ false };
+
+    std::mutex queue_mutex_;  // Очередь новых пачек: пишут потоки сервера, забирает поток кольца
+    std::vector<std::unique_ptr<Batch>> queue_;
+    std::unordered_map<Batch*, std::unique_ptr<Batch>> in_flight_;  // Только поток кольца
+    std::size_t in_flight_ops_ = 0;  // Отправлено в ядро и ещё не завершено
+};
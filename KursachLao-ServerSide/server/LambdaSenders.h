@@ -1,18 +1,41 @@
 ﻿#pragma once
+#include "ConnectionDeadline.h"
+#include "FileRangeBody.h"
+#include "SessionArena.h"
+
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <memory>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
 #include <functional>  // NEW: для std::function колбека после write
 
 #include <iostream>
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <cerrno>
+#endif
+
 namespace beast = boost::beast;
 namespace http = beast::http;
 namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
 
+// Готовый к отправке ответ: сериализованный заголовок + тело, оба ссылаются на
+// неизменяемые буферы, которые держит owner. Пишется одной gather-операцией
+struct prepared_response {
+    std::shared_ptr<const void> owner;
+    std::string_view head;
+    std::string_view body;
+    bool keep_alive = true;
+};
+
 class LambdaSenders {
 public:
     // Sync версия (остаётся для legacy)
@@ -30,37 +53,362 @@ public:
             http::serializer<isRequest, Body, Fields> sr{ msg };
             http::write(stream_, sr, ec_);
         }
+        void operator()(prepared_response&& msg) const {
+            close_ = !msg.keep_alive;
+            const std::array<net::const_buffer, 2> buffers{
+                net::buffer(msg.head.data(), msg.head.size()), net::buffer(msg.body.data(), msg.body.size()) };
+            net::write(stream_, buffers, ec_);
+        }
     };
 
     // Async версия (обновлена: добавлен колбек для after_write)
+    // Конвейер HTTP/1.1 (pipelining): каждый запрос соединения получает слот, ответы уходят
+    // строго в порядке слотов, даже если обработчик ответил позже (промах кэша через io_uring).
+    // Готовые ответы из кэша, накопившиеся подряд, пишутся одной gather-записью
     template<class Stream>
     struct async_send_lambda {
+        // Сколько ответов может ждать отправки. Дальше сессия не читает новые запросы
+        static constexpr std::size_t max_pipeline = 16;
+        // Наибольшая порция одной записи в сокет. После каждой порции таймаут записи
+        // отсчитывается заново: он ограничивает застой, а не время передачи всего ответа
+        static constexpr std::size_t write_chunk = 64 * 1024;
+
         Stream& stream_;
-        bool& close_;
+        bool& close_;  // Поставлен в очередь ответ, после которого соединение закрывается
         std::function<void(beast::error_code)> after_write_cb_;  // NEW: колбек после write (для рекурсии или close)
+        // Владелец отправителя (сессия): каждая запись держит его до своего завершения. Слабая ссылка —
+        // иначе сессия, отправитель и колбек держали бы друг друга вечно
+        std::weak_ptr<void> owner_;
+        session_arena* arena_ = nullptr;  // Откуда брать память под ответы в очереди (nullptr — куча)
+        // Запись без продвижения дольше write_timeout_ обрывает соединение (nullptr — без таймаута)
+        connection_deadline* deadline_ = nullptr;
+        connection_deadline::clock::duration write_timeout_{};
 
         async_send_lambda(Stream& stream, bool& close, std::function<void(beast::error_code)> cb = {})
             : stream_(stream), close_(close), after_write_cb_(cb) {
         }
+        async_send_lambda(const async_send_lambda&) = delete;  // Записи в полёте ссылаются на this
+        async_send_lambda& operator=(const async_send_lambda&) = delete;
+
+        // Слот под следующий запрос соединения
+        std::size_t begin_slot() { return next_slot_++; }
+        bool pipeline_full() const { return next_slot_ - head_ >= max_pipeline; }
+        bool idle() const { return next_slot_ == head_; }
+
+        // Пока отправитель закупорен, готовые ответы только копятся: сессия разбирает запросы,
+        // уже лежащие в буфере, и отпускает их все одной записью
+        void cork(bool corked) {
+            corked_ = corked;
+            if (!corked_) {
+                flush();
+            }
+        }
 
         template<bool isRequest, class Body, class Fields>
-        void operator()(http::message<isRequest, Body, Fields>&& msg) const {
-            close_ = msg.need_eof();  // true если explicit close
-            auto sp = std::make_shared<http::message<isRequest, Body, Fields>>(std::move(msg));
-            http::async_write(
-                stream_,
-                *sp,
-                [this, sp, close_ptr = &close_](beast::error_code ec, std::size_t bytes) {  // NEW: Log bytes
-                    if (after_write_cb_) {
-                        after_write_cb_(ec);
+        void operator()(std::size_t slot, http::message<isRequest, Body, Fields>&& msg) {
+            using message_type = serialized_message<isRequest, Body, Fields>;
+            queued* entry = slot_entry(slot, msg.need_eof());  // true если explicit close
+            if (!entry) {
+                return;
+            }
+            entry->message = std::allocate_shared<message_type>(session_allocator<message_type>(arena_), std::move(msg));
+            entry->write = &write_message<isRequest, Body, Fields>;
+            entry->ready = true;
+            flush();
+        }
+
+        // Заранее сериализованный ответ из кэша: заголовок и тело без serializer, память не выделяется
+        void operator()(std::size_t slot, prepared_response&& msg) {
+            queued* entry = slot_entry(slot, !msg.keep_alive);
+            if (!entry) {
+                return;
+            }
+            entry->prepared = std::move(msg);
+            entry->ready = true;
+            flush();
+        }
+
+#ifdef __linux__
+        // Ответ с http::file_body: заголовок пишет beast, тело уходит через sendfile
+        // прямо из page cache в сокет, минуя user-space буферы
+        template<class Fields>
+        void operator()(std::size_t slot, http::response<http::file_body, Fields>&& msg) {
+            queue_file(slot, std::move(msg));
+        }
+
+        // 206 по большому файлу — тот же sendfile, но со смещением
+        template<class Fields>
+        void operator()(std::size_t slot, http::response<file_range_body, Fields>&& msg) {
+            queue_file(slot, std::move(msg));
+        }
+#endif
+
+    private:
+        struct queued {
+            bool ready = false;
+            bool close = false;
+            std::optional<prepared_response> prepared;  // Пишется вместе с соседями одной записью
+            std::shared_ptr<void> message;              // Прочие ответы — по одному, через write
+            void (*write)(async_send_lambda&, queued&, std::shared_ptr<void>) = nullptr;
+        };
+
+        // Ответ вместе со своим serializer — одним блоком: тело уходит порциями,
+        // и serializer помнит, сколько уже отправлено
+        template<bool isRequest, class Body, class Fields>
+        struct serialized_message {
+            http::message<isRequest, Body, Fields> msg;
+            http::serializer<isRequest, Body, Fields> sr{ msg };
+
+            explicit serialized_message(http::message<isRequest, Body, Fields>&& message)
+                : msg(std::move(message)) {
+                sr.limit(write_chunk);
+            }
+        };
+
+        // Последовательность буферов поверх gather_ без копирования
+        struct buffer_range {
+            using value_type = net::const_buffer;
+            using const_iterator = const net::const_buffer*;
+            const net::const_buffer* first;
+            std::size_t count;
+            const_iterator begin() const { return first; }
+            const_iterator end() const { return first + count; }
+        };
+
+        queued* slot_entry(std::size_t slot, bool close) {
+            if (shut_) {
+                return nullptr;  // Соединение уже закрывается, ответы на запросы после close не нужны
+            }
+            close_ = close_ || close;
+            queued& entry = queue_[slot % max_pipeline];
+            entry.close = close;
+            return &entry;
+        }
+
+#ifdef __linux__
+        template<class Body, class Fields>
+        void queue_file(std::size_t slot, http::response<Body, Fields>&& msg) {
+            using message_type = http::response<Body, Fields>;
+            queued* entry = slot_entry(slot, msg.need_eof());
+            if (!entry) {
+                return;
+            }
+            entry->message = std::make_shared<message_type>(std::move(msg));
+            entry->write = &write_file<Body, Fields>;
+            entry->ready = true;
+            flush();
+        }
+
+        template<class Body, class Fields>
+        static void write_file(async_send_lambda& self, queued& entry, std::shared_ptr<void> owner) {
+            auto& msg = *static_cast<http::response<Body, Fields>*>(entry.message.get());
+            auto op = std::make_shared<sendfile_op<Stream, Body, Fields>>(self.stream_, std::move(msg),
+                [&self](beast::error_code ec) { self.on_written(ec, 1); }, std::move(owner));
+            op->progress_cb_ = [&self]() { self.start_write_deadline(); };
+            op->start();
+        }
+#endif
+
+        // Пишет ответ по одной порции serializer за вызов, продлевая таймаут после каждой
+        template<bool isRequest, class Body, class Fields>
+        static void write_message(async_send_lambda& self, queued& entry, std::shared_ptr<void> owner) {
+            auto& message = *static_cast<serialized_message<isRequest, Body, Fields>*>(entry.message.get());
+            http::async_write_some(self.stream_, message.sr, bind_arena(self.arena_,
+                [&self, &entry, &message, owner = std::move(owner)](beast::error_code ec, std::size_t) mutable {
+                    if (ec || message.sr.is_done()) {
+                        return self.on_written(ec, 1);
                     }
-                    if (!ec && *close_ptr) {
-                        // FIXED: Half-close (shutdown_send) — client reads response, но no more writes
-                        beast::error_code sec;
-                        beast::get_lowest_layer(stream_).shutdown(net::socket_base::shutdown_send, sec);
+                    self.start_write_deadline();
+                    write_message<isRequest, Body, Fields>(self, entry, std::move(owner));
+                }));
+        }
+
+        // Отправляет то, что готово с головы очереди. Одновременно в сокет идёт одна запись
+        void flush() {
+            if (writing_ || corked_ || shut_ || idle()) {
+                return;
+            }
+            queued& first = queue_[head_ % max_pipeline];
+            if (!first.ready) {
+                return;  // Ответ на более ранний запрос ещё не готов
+            }
+            writing_ = true;
+            start_write_deadline();
+            auto owner = owner_.lock();
+            if (!first.prepared) {
+                first.write(*this, first, std::move(owner));
+                return;
+            }
+            std::size_t count = 0;
+            std::size_t buffers = 0;
+            while (head_ + count < next_slot_) {
+                queued& entry = queue_[(head_ + count) % max_pipeline];
+                if (!entry.ready || !entry.prepared) {
+                    break;
+                }
+                gather_[buffers++] = net::buffer(entry.prepared->head.data(), entry.prepared->head.size());
+                gather_[buffers++] = net::buffer(entry.prepared->body.data(), entry.prepared->body.size());
+                ++count;
+                if (entry.close) {
+                    break;
+                }
+            }
+            // Условие завершения вызывается перед каждой порцией: прошлая ушла — таймаут заново
+            net::async_write(stream_, buffer_range{ gather_.data(), buffers },
+                [this](beast::error_code ec, std::size_t) -> std::size_t {
+                    if (ec) {
+                        return 0;
                     }
-                    //std::cout << "Wrote " << bytes << " bytes, close=" << *close_ptr << std::endl;  // Debug log
+                    start_write_deadline();
+                    return write_chunk;
+                },
+                bind_arena(arena_, [this, owner = std::move(owner), count](beast::error_code ec, std::size_t) {
+                    on_written(ec, count);
+                }));
+        }
+
+        void start_write_deadline() {
+            if (deadline_) {
+                deadline_->start(connection_deadline::write, write_timeout_);
+            }
+        }
+
+        void on_written(beast::error_code ec, std::size_t count) {
+            writing_ = false;
+            if (deadline_) {
+                deadline_->stop(connection_deadline::write);
+            }
+            bool close = false;
+            for (std::size_t i = 0; i < count; ++i) {
+                queued& entry = queue_[head_ % max_pipeline];
+                close = close || entry.close;
+                entry = queued{};
+                ++head_;
+            }
+            if (ec || close) {
+                shut_ = true;
+            }
+            if (!ec && close) {
+                // FIXED: Half-close (shutdown_send) — client reads response, но no more writes
+                beast::error_code sec;
+                beast::get_lowest_layer(stream_).shutdown(net::socket_base::shutdown_send, sec);
+            }
+            if (after_write_cb_) {
+                after_write_cb_(ec);
+            }
+            flush();
+        }
+
+        std::array<queued, max_pipeline> queue_;
+        std::array<net::const_buffer, 2 * max_pipeline> gather_;
+        std::size_t head_ = 0;       // Слот, чей ответ уходит следующим
+        std::size_t next_slot_ = 0;  // Слот следующего запроса
+        bool writing_ = false;
+        bool corked_ = false;
+        bool shut_ = false;
+    };
+
+    // Копируемая обёртка над async_send_lambda для ответа позже, из колбека (промах кэша,
+    // который читает io_uring). sender_ — алиас на член сессии: копия держит саму сессию
+    // и ничего не выделяет. slot_ — место ответа в конвейере, get_executor() — куда вернуться
+    // с готовым ответом
+    template<class Stream>
+    struct shared_send_lambda {
+        std::shared_ptr<async_send_lambda<Stream>> sender_;
+        std::size_t slot_ = 0;
+
+        template<class Message>
+        void operator()(Message&& msg) const {
+            (*sender_)(slot_, std::forward<Message>(msg));
+        }
+        auto get_executor() const {
+            return sender_->stream_.get_executor();
+        }
+    };
+
+#ifdef __linux__
+    // Какой отрезок файла отправлять для каждого поддерживаемого тела
+    static std::pair<std::uint64_t, std::uint64_t> sendfile_span(http::file_body::value_type& body) {
+        return { 0, body.size() };
+    }
+    static std::pair<std::uint64_t, std::uint64_t> sendfile_span(file_range_body::value_type& body) {
+        return { body.offset(), body.length() };
+    }
+
+    template<class Stream, class Body, class Fields>
+    struct sendfile_op : std::enable_shared_from_this<sendfile_op<Stream, Body, Fields>> {
+        Stream& stream_;
+        http::response<Body, Fields> msg_;
+        http::response_serializer<Body, Fields> sr_;
+        std::function<void(beast::error_code)> after_write_cb_;
+        std::function<void()> progress_cb_;  // Тело продвинулось — продлить таймаут записи
+        std::shared_ptr<void> owner_;
+        off_t offset_ = 0;
+        std::uint64_t remaining_ = 0;
+
+        sendfile_op(Stream& stream, http::response<Body, Fields>&& msg,
+            std::function<void(beast::error_code)> cb, std::shared_ptr<void> owner)
+            : stream_(stream), msg_(std::move(msg)), sr_(msg_), after_write_cb_(std::move(cb)), owner_(std::move(owner)) {
+            auto [offset, length] = sendfile_span(msg_.body());
+            offset_ = static_cast<off_t>(offset);
+            remaining_ = length;
+        }
+
+        void start() {
+            http::async_write_header(stream_, sr_,
+                [self = this->shared_from_this()](beast::error_code ec, std::size_t) {
+                    if (ec) {
+                        return self->finish(ec);
+                    }
+                    self->send_chunk();
                 });
         }
+
+        void send_chunk() {
+            auto& socket = beast::get_lowest_layer(stream_);
+            beast::error_code ec;
+            socket.native_non_blocking(true, ec);
+            if (ec) {
+                return finish(ec);
+            }
+            int file_fd = msg_.body().file().native_handle();
+            while (remaining_ > 0) {
+                ssize_t n = ::sendfile(socket.native_handle(), file_fd, &offset_, static_cast<std::size_t>(remaining_));
+                if (n > 0) {
+                    remaining_ -= static_cast<std::uint64_t>(n);
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    // Буфер сокета заполнен — ждём готовности на запись
+                    if (progress_cb_) {
+                        progress_cb_();
+                    }
+                    socket.async_wait(tcp::socket::wait_write,
+                        [self = this->shared_from_this()](beast::error_code wec) {
+                            if (wec) {
+                                return self->finish(wec);
+                            }
+                            self->send_chunk();
+                        });
+                    return;
+                }
+                // n == 0 — файл укоротился, досылать нечего
+                return finish(n == 0
+                    ? beast::error_code(net::error::eof)
+                    : beast::error_code(errno, boost::system::system_category()));
+            }
+            finish({});
+        }
+
+        // Закрытие соединения после ответа — забота отправителя
+        void finish(beast::error_code ec) {
+            if (after_write_cb_) {
+                after_write_cb_(ec);
+            }
+        }
     };
+#endif
 };
\ No newline at end of file
@@ -0,0 +1,120 @@
+﻿#pragma once
+
+#include "RequestHandler.h"
+#include "Session.h"
+#include "DoSProtectionModule.h"
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+
+#include <iostream>
+#include <memory>
+
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+namespace beast = boost::beast;
+
+#ifdef SO_REUSEPORT
+using reuse_port_option = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+// Цикл приёма соединений. В общем пуле — один listener на io_context с N потоками,
+// в режиме шардов — по одному listener на каждый io_context (SO_REUSEPORT).
+// После пробуждения забирает из очереди listen до accept_batch соединений
+// неблокирующим accept, не возвращаясь каждый раз в реактор.
+class listener : public std::enable_shared_from_this<listener> {
+public:
+    struct Options {
+        bool reuse_port = false;          // SO_REUSEPORT — ядро само раскидывает соединения по акцепторам
+        bool strand_per_session = true;   // Нужен только если io_context крутится на нескольких потоках
+        std::size_t accept_batch = 16;    // Максимум соединений за одно пробуждение
+        bool log_connections = false;
+        session::Options session_options; // Таймауты и лимит запросов соединения
+    };
+
+    listener(net::io_context& ioc, const tcp::endpoint& endpoint,
+        RequestHandler* handler, DoSProtectionModule* dos, Options options)
+        : ioc_(ioc), acceptor_(ioc), handler_(handler), dos_(dos), options_(options) {
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(net::socket_base::reuse_address(true));
+        if (options_.reuse_port) {
+#ifdef SO_REUSEPORT
+            acceptor_.set_option(reuse_port_option(true));
+#else
+            throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#endif
+        }
+        acceptor_.bind(endpoint);
+        acceptor_.listen(net::socket_base::max_listen_connections);
+        acceptor_.non_blocking(true);  // Для добора очереди синхронным accept без блокировки
+    }
+
+    void run() {
+        do_accept();
+    }
+
+private:
+    net::any_io_executor session_executor() {
+        if (options_.strand_per_session) {
+            return net::make_strand(ioc_);
+        }
+        return ioc_.get_executor();
+    }
+
+    void do_accept() {
+        acceptor_.async_accept(session_executor(),
+            [self = shared_from_this()](beast::error_code ec, tcp::socket socket) {
+                self->on_accept(ec, std::move(socket));
+            });
+    }
+
+    void on_accept(beast::error_code ec, tcp::socket socket) {
+        if (ec) {
+            if (ec == net::error::operation_aborted) {
+                return;
+            }
+            std::cerr << "Accept error: " << ec.message() << std::endl;
+        }
+        else {
+            handle_connection(std::move(socket));
+            // Добираем уже установленные соединения, пока очередь не опустеет
+            for (std::size_t i = 1; i < options_.accept_batch; ++i) {
+                tcp::socket next(session_executor());
+                beast::error_code aec;
+                acceptor_.accept(next, aec);
+                if (aec) {
+                    if (aec != net::error::would_block && aec != net::error::try_again) {
+                        std::cerr << "Accept error: " << aec.message() << std::endl;
+                    }
+                    break;
+                }
+                handle_connection(std::move(next));
+            }
+        }
+        do_accept();
+    }
+
+    void handle_connection(tcp::socket socket) {
+        beast::error_code ec;
+        auto remote = socket.remote_endpoint(ec);
+        if (ec) {
+            return;  // Клиент уже отвалился
+        }
+        std::string ip = remote.address().to_string();
+        if (options_.log_connections) {
+            std::cout << "Client connected from: " << ip << ":" << remote.port() << std::endl;
+        }
+        if (!dos_->isAllowed(ip)) {
+            std::cout << "[" << ip << "] Connection terminated: DoS protection triggered (rate limit exceeded)\n";
+            return;
+        }
+        std::make_shared<session>(std::move(socket), handler_, options_.session_options)->run();
+    }
+
+    net::io_context& ioc_;
+    tcp::acceptor acceptor_;
+    RequestHandler* handler_;
+    DoSProtectionModule* dos_;
+    Options options_;
+};
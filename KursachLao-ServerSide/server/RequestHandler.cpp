@@ -1,25 +1,142 @@
 ﻿#include "RequestHandler.h"
 #include <iostream>
+#include <algorithm>
+#include <charconv>
 
 RequestHandler::RequestHandler()
     : BaseModule("HTTP Request Handler") {
 }
 
-void RequestHandler::addDynamicRouteHandler(const std::string& regexPattern,
-    std::function<void(const http::request<http::string_body>&, http::response<http::string_body>&)> handler) {
+void RequestHandler::addRoute(http::verb method, std::string_view pattern, Router::Handler handler) {
     try {
-        std::regex re(regexPattern);  // Компилируем regex заранее для эффективности
-        dynamicRouteHandlers_.emplace_back(re, handler);
+        router_.add(method, pattern, std::move(handler));
     }
-    catch (const std::regex_error& e) {
-        std::cerr << "Invalid regex pattern: " << regexPattern << " - " << e.what() << std::endl;
+    catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl;
         // Для MVP: не добавляем, но не крашим
     }
 }
 
+void RequestHandler::addAsyncRoute(http::verb method, std::string_view pattern, Router::AsyncHandler handler) {
+    try {
+        router_.add_async(method, pattern, std::move(handler));
+    }
+    catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+// Список ETag из If-None-Match: "*" или "a", W/"b". Для If-None-Match используется
+// слабое сравнение — префикс W/ игнорируется с обеих сторон
+bool RequestHandler::etagListMatches(std::string_view list, std::string_view etag) {
+    auto strip_weak = [](std::string_view tag) {
+        if (tag.size() >= 2 && tag[0] == 'W' && tag[1] == '/') {
+            tag.remove_prefix(2);
+        }
+        return tag;
+    };
+    etag = strip_weak(etag);
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string_view::npos) {
+            end = list.size();
+        }
+        std::string_view item = list.substr(pos, end - pos);
+        pos = end + 1;
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (item == "*" || strip_weak(item) == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RequestHandler::strongEtagEquals(std::string_view lhs, std::string_view rhs) {
+    // Слабые теги при строгом сравнении не совпадают ни с чем (RFC 9110, 8.8.3.2)
+    if (lhs.substr(0, 2) == "W/" || rhs.substr(0, 2) == "W/") {
+        return false;
+    }
+    return lhs == rhs;
+}
+
+RequestHandler::RangeResult RequestHandler::parseRange(std::string_view header, std::uint64_t size, std::vector<ByteRange>& ranges) {
+    constexpr size_t max_ranges = 16;  // Больше отрезков — подозрительно, отдаём файл целиком
+    constexpr std::string_view unit = "bytes=";
+    ranges.clear();
+    if (header.substr(0, unit.size()) != unit) {
+        return RangeResult::None;
+    }
+    header.remove_prefix(unit.size());
+
+    auto parse_number = [](std::string_view text, std::uint64_t& value) {
+        if (text.empty()) {
+            return false;
+        }
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc() && ptr == text.data() + text.size();
+    };
+
+    size_t items = 0;
+    size_t pos = 0;
+    while (pos <= header.size()) {
+        size_t end = header.find(',', pos);
+        if (end == std::string_view::npos) {
+            end = header.size();
+        }
+        std::string_view item = header.substr(pos, end - pos);
+        pos = end + 1;
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (item.empty()) {
+            continue;  // Пустые элементы списка допускаются
+        }
+        if (++items > max_ranges) {
+            return RangeResult::None;
+        }
+        size_t dash = item.find('-');
+        if (dash == std::string_view::npos) {
+            return RangeResult::None;
+        }
+        std::string_view first_text = item.substr(0, dash);
+        std::string_view last_text = item.substr(dash + 1);
+        std::uint64_t first = 0;
+        std::uint64_t last = 0;
+        if (first_text.empty()) {
+            // "-n" — последние n байт
+            if (!parse_number(last_text, last)) {
+                return RangeResult::None;
+            }
+            if (last == 0 || size == 0) {
+                continue;
+            }
+            ranges.push_back({ last >= size ? 0 : size - last, size - 1 });
+            continue;
+        }
+        if (!parse_number(first_text, first)) {
+            return RangeResult::None;
+        }
+        if (last_text.empty()) {
+            last = size - 1;
+        }
+        else if (!parse_number(last_text, last) || last < first) {
+            return RangeResult::None;
+        }
+        if (first >= size) {
+            continue;  // Отрезок за концом файла — невыполним, но остальные могут подойти
+        }
+        ranges.push_back({ first, std::min(last, size - 1) });
+    }
+    if (items == 0) {
+        return RangeResult::None;
+    }
+    return ranges.empty() ? RangeResult::Unsatisfiable : RangeResult::Satisfiable;
+}
+
 bool RequestHandler::onInitialize() {
     setupDefaultRoutes();
-    std::cout << "RequestHandler initialized with " << routeHandlers_.size() << " routes" << std::endl;
+    std::cout << "RequestHandler initialized with " << router_.size() << " routes" << std::endl;
     if (file_cache_) {
         std::cout << "FileCache linked successfully." << std::endl;  // NEW: Лог для отладки
     }
@@ -27,13 +144,38 @@ bool RequestHandler::onInitialize() {
 }
 
 void RequestHandler::onShutdown() {
-    routeHandlers_.clear();
+    router_.clear();
     std::cout << "RequestHandler shutdown" << std::endl;
 }
 
 void RequestHandler::addRouteHandler(const std::string& path,
     std::function<void(const http::request<http::string_body>&, http::response<http::string_body>&)> handler) {
-    routeHandlers_[path] = handler;
+    if (path == "/*") {
+        serve_static_ = true;  // Не маршрут, а признак: остальное ищется в FileCache
+        return;
+    }
+    addRoute(http::verb::unknown, path,
+        [handler = std::move(handler)](const Router::Request& req, Router::Response& res, const RouteParams&) {
+            handler(req, res);
+        });
+}
+
+// Номер снимка растёт при любой публикации в FileCache, поэтому страница перечитывается
+// после изменений кэша, но поток сканера с одними 404 берёт её из кэша один раз
+FileCache::FileHandle RequestHandler::notFoundPage() {
+    struct PinnedPage {
+        const RequestHandler* owner = nullptr;
+        std::uint64_t generation = 0;
+        FileCache::FileHandle page;
+    };
+    thread_local PinnedPage pinned;
+    const std::uint64_t generation = file_cache_->generation();
+    if (pinned.owner != this || pinned.generation != generation || !pinned.page) {
+        pinned.owner = this;
+        pinned.generation = generation;
+        pinned.page = file_cache_->get_file(not_found_route);
+    }
+    return pinned.page;
 }
 
 void RequestHandler::setupDefaultRoutes() { //Придумать какую-нибудь штуку для замены стандартного обработчика
@@ -1,26 +1,35 @@
 ﻿#pragma once
 #include "BaseModule.h"
 #include "FileCache.h"
+#include "SharedBufferBody.h"
+#include "LambdaSenders.h"
+#include "HttpDate.h"
+#include "Router.h"
 
 #include <boost/beast/http.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/post.hpp>
 #include <sstream>
 #include <fstream>
-#include <regex>
 #include <vector>
-#include <unordered_map>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
 
 namespace beast = boost::beast;
 namespace http = beast::http;
 
 class RequestHandler : public BaseModule {
     FileCache* file_cache_ = nullptr;  // Указатель на кэш (инжектируется в main)
+    bool serve_static_ = false;        // Зарегистрирован маршрут /* — раздаём файлы из кэша
 
 
-    // Парсинг target на path и query (простой split по ?)
-    std::pair<std::string, std::string> parseTarget(const std::string& target) {
+    // Парсинг target на path и query (простой split по ?). Срезы target — без копирования
+    static std::pair<std::string_view, std::string_view> parseTarget(std::string_view target) {
         size_t pos = target.find('?');
-        if (pos == std::string::npos) {
-            return { target, "" };  // Нет query
+        if (pos == std::string_view::npos) {
+            return { target, {} };  // Нет query
         }
         return { target.substr(0, pos), target.substr(pos + 1) };  // path, query
     }
@@ -34,96 +43,475 @@ public:
 
     }
 
-    // Новый метод для динамических роутов (regex-паттерн)
-    void addDynamicRouteHandler(const std::string& regexPattern,
-        std::function<void(const http::request<http::string_body>&, http::response<http::string_body>&)> handler);
+    // Маршрут с параметрами и своим обработчиком на каждый метод:
+    // addRoute(http::verb::put, "/api/employees/{id:int}", ...). Шаблоны — см. Router
+    void addRoute(http::verb method, std::string_view pattern, Router::Handler handler);
+    // То же для обработчика-корутины: он может ждать (co_await), пока поток обслуживает
+    // другие соединения. Ответ уходит, когда корутина завершится, — в свою очередь конвейера
+    void addAsyncRoute(http::verb method, std::string_view pattern, Router::AsyncHandler handler);
+
+    // Методы для регистрации обработчиков конкретных путей (любой метод)
+    // Регистрировать маршруты можно только до запуска воркеров: во время работы таблицы
+    // маршрутов читаются из нескольких потоков без блокировок
 
-    // Методы для регистрации обработчиков конкретных путей
     void addRouteHandler(const std::string& path, std::function<void(const http::request<http::string_body>&, http::response<http::string_body>&)> handler);
 
     template<class Body, class Allocator, class Send>
     void handleRequest(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send) {
+        // Server и Connection ставит setDefaultHeaders — только ответам, которые собирает beast.
+        // Ответ из кэша по HTTP/1.1 уходит с готовым заголовком, и res для него не трогает кучу
         http::response<http::string_body> res{ http::status::not_found, req.version() };
-        res.set(http::field::server, "ModularServer");
         res.keep_alive(req.keep_alive());
-        // Explicit Connection header для force keep-alive (если !reиq.keep_alive(), но для MVP — всегда true для 1.1)
-        if (req.version() >= 11 && res.keep_alive()) {
-            res.set(http::field::connection, "keep-alive");
-        }
 
-        std::string target = std::string(req.target());
+        const std::string_view target(req.target().data(), req.target().size());
         auto [path, query] = parseTarget(target);
 
-        // Проверяем wildcard /* для динамического поиска в кэше (только по path!)
-        auto wildcard_it = routeHandlers_.find("/*"); //FIXME: Повышает время отклика
-        if (wildcard_it != routeHandlers_.end() && file_cache_) {
-            file_cache_->refresh_file(path);
-            auto cached_file = file_cache_->get_file(path);  // Ищем по чистому path
+        // Сканеры перебирают несуществующие пути: такой запрос отсекается фильтром Блума
+        // и получает готовую 404 — без поиска в кэше и дереве маршрутов
+        if (isUnknownPath(path, target)) {
+            sendNotFound(req, res, send);
+            return;
+        }
+
+        // Wildcard /* — динамический поиск в кэше (только по path!)
+        if (serve_static_ && file_cache_) {
+            // Большие файлы — без копирования в user-space: http::file_body (sendfile на Linux)
+            auto streamed = file_cache_->get_streamed_file(path);
+            if (streamed) {
+                setDefaultHeaders(res);
+                beast::error_code ec;
+                http::file_body::value_type body;
+                body.open(streamed->file_path.string().c_str(), beast::file_mode::scan, ec);
+                if (!ec) {
+                    if (isNotModified(req, streamed->etag, streamed->last_modified)) {
+                        http::response<http::empty_body> not_modified;
+                        not_modified.base() = res.base();
+                        not_modified.result(http::status::not_modified);
+                        not_modified.set(http::field::cache_control, "public, max-age=300");
+                        not_modified.set(http::field::etag, streamed->etag);
+                        not_modified.set(http::field::last_modified, http_date::format(streamed->last_modified));
+                        send(std::move(not_modified));
+                        return;
+                    }
+                    auto range_field = req[http::field::range];
+                    if (req.method() == http::verb::get && !range_field.empty()
+                        && ifRangeMatches(req, streamed->etag, streamed->last_modified)) {
+                        std::vector<ByteRange> ranges;
+                        auto range_result = parseRange(std::string_view(range_field.data(), range_field.size()), streamed->size, ranges);
+                        if (range_result == RangeResult::Unsatisfiable) {
+                            sendRangeNotSatisfiable(res, streamed->size, send);
+                            return;
+                        }
+                        // Несколько отрезков файла с диска в multipart не собираем — ниже уйдёт весь файл (200)
+                        if (range_result == RangeResult::Satisfiable && ranges.size() == 1) {
+                            const auto& range = ranges.front();
+                            http::response<file_range_body> part_res{ http::status::partial_content, req.version() };
+                            part_res.base() = res.base();
+                            part_res.result(http::status::partial_content);
+                            part_res.body().open(streamed->file_path.string().c_str(), range.first, range.length(), ec);
+                            if (!ec) {
+                                part_res.set(http::field::content_type, streamed->mime_type);
+                                part_res.set(http::field::cache_control, "public, max-age=300");
+                                part_res.set(http::field::etag, streamed->etag);
+                                part_res.set(http::field::last_modified, http_date::format(streamed->last_modified));
+                                part_res.set(http::field::content_range, contentRange(range, streamed->size));
+                                part_res.prepare_payload();
+                                send(std::move(part_res));
+                                return;
+                            }
+                        }
+                    }
+                    http::response<http::file_body> file_res{ http::status::ok, req.version() };
+                    file_res.base() = res.base();
+                    file_res.result(http::status::ok);
+                    file_res.set(http::field::content_type, streamed->mime_type);
+                    file_res.set(http::field::cache_control, "public, max-age=300");
+                    file_res.set(http::field::etag, streamed->etag);
+                    file_res.set(http::field::last_modified, http_date::format(streamed->last_modified));
+                    file_res.set(http::field::accept_ranges, "bytes");
+                    file_res.body() = std::move(body);
+                    file_res.prepare_payload();
+                    send(std::move(file_res));
+                    return;
+                }
+            }
+            // Актуальность кэша поддерживает FileWatcher — здесь к файловой системе не обращаемся
+            auto cached_file = file_cache_->find_cached(path);  // Ищем по чистому path
+            if (!cached_file) {
+                // Промах: если отправитель умеет ответить позже, файл читает io_uring, а поток свободен
+                if constexpr (requires { send.get_executor(); }) {
+                    if (sendFileAsync(std::string(path), req, res, send)) {
+                        return;
+                    }
+                }
+                cached_file = file_cache_->get_file(std::string(path));
+            }
             if (cached_file) {
-                res.set(http::field::content_type, cached_file->mime_type.c_str());
-                res.set(http::field::cache_control, "public, max-age=300");
-                res.body() = std::move(cached_file->content);
-                res.result(http::status::ok);
-                res.prepare_payload();
-                send(std::move(res));
+                sendCachedFile(req, res, cached_file, http::status::ok, send);
                 return;
             }
         }
 
-		// Добавлена динамика по regex-паттернам
-        auto it = routeHandlers_.find(path);
-        if (it != routeHandlers_.end()) {
-            // Передаём query в handler (если lambda ожидает — расширь signature)
-            // Для MVP: если handler статический, игнорируем query
-            it->second(req, res); 
+        setDefaultHeaders(res);
+        // Параметры пути и query доходят до обработчика срезами target
+        RouteParams params(query);
+        auto route = router_.find(req.method(), path, params);
+        if (route.status == Router::Status::found) {
+            if (route.async_route) {
+                spawnAsyncHandler(std::move(route.async_route), req, res, params, send);
+                return;
+            }
+            (*route.handler)(handlerRequest(req), res, params);
             res.prepare_payload();
             send(std::move(res));
             return;
         }
-        else if (target.find("../") != std::string::npos) {
-            res.set(http::field::content_type, "text/html");
-            file_cache_->refresh_file("/attention.html");
-            const auto& cached = file_cache_->get_file("/attention.html");
-            res.set(http::field::cache_control, "public, max-age=300");
-            res.body() = cached.value().content;
+        if (route.status == Router::Status::method_not_allowed) {
+            res.result(http::status::method_not_allowed);
+            res.set(http::field::allow, beast::string_view(route.allow.data(), route.allow.size()));
+            res.set(http::field::content_type, "application/json");
+            res.set(http::field::cache_control, "no-cache, must-revalidate");
+            res.body() = R"({"status": "method_not_allowed"})";
             res.prepare_payload();
             send(std::move(res));
             return;
+        }
+        if (target.find("../") != std::string_view::npos) {
+            sendErrorPage(req, res, "/attention.html", send);
+            return;
+        }
+        if (target.find("api/") != std::string_view::npos) {
+            res.set(http::field::content_type, "application/json");
+            res.result(http::status::not_found);
+            res.set(http::field::cache_control, "no-cache, must-revalidate");
+            res.body() = R"({"status": "not_found"})";
+            res.prepare_payload();
+            send(std::move(res));
+            return;
+        }
+        sendNotFound(req, res, send);
+    }
+
+private:
+    static constexpr const char* not_found_route = "/errorNotFound.html";
 
+    // Путь не ведёт ни к файлу, ни к обработчику. "../" и api/ сюда не попадают — у них свои ответы
+    bool isUnknownPath(std::string_view path, std::string_view target) const {
+        if (target.find("../") != std::string_view::npos || target.find("api/") != std::string_view::npos) {
+            return false;
         }
-        if (it == routeHandlers_.end() && !dynamicRouteHandlers_.empty()) { //FIXME: Съедает 404 страничку (Уже нет, но переработать стоит). Сделать нормальную валидацию
-            bool handled = false;
-            for (const auto& [re, handler] : dynamicRouteHandlers_) {
-                if (std::regex_match(path, re)) {  // Матчим весь path с regex
-                    handler(req, res);
-                    handled = true;
-                    break;  // Первый матч — обрабатываем (порядок в векторе важен: более конкретные выше)
-                }
+        if (serve_static_ && file_cache_ && file_cache_->may_have_route(path)) {
+            return false;
+        }
+        return !router_.has_route(path);
+    }
+
+    // Страница 404, закреплённая за потоком до смены снимка FileCache
+    FileCache::FileHandle notFoundPage();
+
+    template<class Message>
+    static void setDefaultHeaders(Message& res) {
+        res.set(http::field::server, "ModularServer");
+        // Explicit Connection header для force keep-alive (если !req.keep_alive(), но для MVP — всегда true для 1.1)
+        if (res.version() >= 11 && res.keep_alive()) {
+            res.set(http::field::connection, "keep-alive");
+        }
+    }
+
+    // Обработчики принимают запрос с обычным аллокатором. Запрос из арены сессии для них
+    // копируется — на пути к кэшу этого не происходит
+    template<class Request>
+    static decltype(auto) handlerRequest(const Request& req) {
+        if constexpr (std::is_same_v<Request, http::request<http::string_body>>) {
+            return (req);
+        }
+        else {
+            http::request<http::string_body> copy;
+            copy.method_string(req.method_string());
+            copy.target(req.target());
+            copy.version(req.version());
+            for (const auto& field : req) {
+                copy.insert(field.name_string(), field.value());
             }
-            if (handled) {
-                res.prepare_payload();
-                send(std::move(res));
-                return;
+            copy.body() = req.body();
+            return copy;
+        }
+    }
+
+    // Корутина получает свой маршрут, свои копии запроса и ответа и отправитель, который держит
+    // сессию. Отвечать позже умеет только отправитель с executor'ом (shared_send_lambda сессии)
+    template<class Request, class Send>
+    void spawnAsyncHandler(std::shared_ptr<const Router::AsyncRoute> route, const Request& req,
+        http::response<http::string_body>& res, const RouteParams& params, Send& send) {
+        static_assert(requires { send.get_executor(); },
+            "async routes need a sender that can reply later (with get_executor())");
+        // Параметры — срезы target исходного запроса: переносим их на копию, пока исходный жив.
+        // Перемещение запроса в кадр корутины буфер target не перевыделяет
+        Router::Request copy = handlerRequest(req);
+        const std::string_view from(req.target().data(), req.target().size());
+        const std::string_view to(copy.target().data(), copy.target().size());
+        RouteParams copy_params = params.rebased(from, to, route->param_names);
+        net::co_spawn(send.get_executor(),
+            runAsyncHandler(std::move(route), std::move(copy), std::move(res), copy_params, std::decay_t<Send>(send)),
+            net::detached);
+    }
+
+    template<class Send>
+    static net::awaitable<void> runAsyncHandler(std::shared_ptr<const Router::AsyncRoute> route,
+        Router::Request req, Router::Response res, RouteParams params, Send send) {
+        try {
+            co_await route->handler(req, res, params);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Async handler error (" << req.target() << "): " << e.what() << std::endl;
+            res.result(http::status::internal_server_error);
+            res.set(http::field::content_type, "application/json");
+            res.body() = R"({"status": "internal_error"})";
+        }
+        res.prepare_payload();
+        send(std::move(res));
+    }
+
+    // If-None-Match приоритетнее If-Modified-Since (RFC 9110, 13.2.2)
+    template<class Request>
+    static bool isNotModified(const Request& req, std::string_view etag, std::chrono::system_clock::time_point last_modified) {
+        if (req.method() != http::verb::get && req.method() != http::verb::head) {
+            return false;
+        }
+        auto if_none_match = req[http::field::if_none_match];
+        if (!if_none_match.empty()) {
+            return etagListMatches(std::string_view(if_none_match.data(), if_none_match.size()), etag);
+        }
+        auto if_modified_since = req[http::field::if_modified_since];
+        if (!if_modified_since.empty()) {
+            auto since = http_date::parse(std::string_view(if_modified_since.data(), if_modified_since.size()));
+            return since && std::chrono::floor<std::chrono::seconds>(last_modified) <= *since;
+        }
+        return false;
+    }
+    static bool etagListMatches(std::string_view list, std::string_view etag);
+
+    // Отрезок [first, last] из заголовка Range, границы включительно
+    struct ByteRange {
+        std::uint64_t first;
+        std::uint64_t last;
+
+        std::uint64_t length() const { return last - first + 1; }
+    };
+    // None — заголовка нет, он с ошибкой или отрезков слишком много (тогда отдаём весь файл)
+    enum class RangeResult { None, Satisfiable, Unsatisfiable };
+    static RangeResult parseRange(std::string_view header, std::uint64_t size, std::vector<ByteRange>& ranges);
+    static bool strongEtagEquals(std::string_view lhs, std::string_view rhs);
+    static std::string contentRange(const ByteRange& range, std::uint64_t size) {
+        return "bytes " + std::to_string(range.first) + "-" + std::to_string(range.last) + "/" + std::to_string(size);
+    }
+
+    // If-Range: отрезок отдаём, только если у клиента та же версия файла (ETag сравнивается строго,
+    // дата — с точностью до секунды). Иначе — полный ответ 200
+    template<class Request>
+    static bool ifRangeMatches(const Request& req, std::string_view etag, std::chrono::system_clock::time_point last_modified) {
+        auto if_range = req[http::field::if_range];
+        if (if_range.empty()) {
+            return true;
+        }
+        std::string_view value(if_range.data(), if_range.size());
+        if (value.front() == '"' || value.substr(0, 2) == "W/") {
+            return strongEtagEquals(value, etag);
+        }
+        auto date = http_date::parse(value);
+        return date && std::chrono::floor<std::chrono::seconds>(last_modified) == *date;
+    }
+
+    template<class Send>
+    void sendRangeNotSatisfiable(const http::response<http::string_body>& base, std::uint64_t size, Send&& send) {
+        http::response<http::empty_body> res;
+        res.base() = base.base();
+        setDefaultHeaders(res);
+        res.result(http::status::range_not_satisfiable);
+        res.set(http::field::content_range, "bytes */" + std::to_string(size));
+        res.prepare_payload();
+        send(std::move(res));
+    }
+
+    // 206 по представлению из кэша: один отрезок — срез буфера, несколько — multipart/byteranges.
+    // Возвращает false, если Range нужно проигнорировать и отдать файл целиком
+    template<class Request, class Send>
+    bool sendCachedRange(const Request& req, const http::response<http::string_body>& base,
+        const FileCache::FileHandle& file, FileCache::Encoding encoding, Send& send) {
+        const auto& representation = file->representation(encoding);
+        auto range_field = req[http::field::range];
+        if (req.method() != http::verb::get || range_field.empty()
+            || !ifRangeMatches(req, representation.etag, file->last_modified)) {
+            return false;
+        }
+        const std::uint64_t size = representation.content.size();
+        std::vector<ByteRange> ranges;
+        auto range_result = parseRange(std::string_view(range_field.data(), range_field.size()), size, ranges);
+        if (range_result == RangeResult::None) {
+            return false;
+        }
+        if (range_result == RangeResult::Unsatisfiable) {
+            sendRangeNotSatisfiable(base, size, send);
+            return true;
+        }
+        std::string_view content = representation.content;
+        auto set_common = [&](auto& res) {
+            res.base() = base.base();
+            setDefaultHeaders(res);
+            res.result(http::status::partial_content);
+            res.set(http::field::cache_control, file->cache_control());
+            res.set(http::field::etag, representation.etag);
+            res.set(http::field::last_modified, file->last_modified_http);
+            if (encoding != FileCache::Encoding::Identity) {
+                res.set(http::field::content_encoding, FileCache::encoding_name(encoding));
             }
-            else if (target.find("api/") != std::string::npos) {
-                res.set(http::field::content_type, "application/json");
-                res.result(http::status::not_found);
-                res.set(http::field::cache_control, "no-cache, must-revalidate");
-                res.body() = R"({"status": "not_found"})";
-                res.prepare_payload();
-                send(std::move(res));
-                return;
+            if (file->vary_encoding) {
+                res.set(http::field::vary, "Accept-Encoding");
             }
-            else {
-                res.set(http::field::content_type, "text/html");
-                file_cache_->refresh_file("/errorNotFound.html");
-                const auto& cached = file_cache_->get_file("/errorNotFound.html");
-                res.set(http::field::cache_control, "public, max-age=300");
-                res.body() = cached.value().content;
-                res.prepare_payload();
-                send(std::move(res));
+        };
+        if (ranges.size() == 1) {
+            http::response<shared_buffer_body> res;
+            set_common(res);
+            res.set(http::field::content_type, file->mime_type);
+            res.set(http::field::content_range, contentRange(ranges.front(), size));
+            res.body().owner = file;
+            res.body().data = content.substr(ranges.front().first, ranges.front().length());
+            res.prepare_payload();
+            send(std::move(res));
+            return true;
+        }
+        // Хэш содержимого в разделителе: в самих байтах файла такая строка практически не встречается
+        const std::string boundary = "KursachRange" + file->content_hash;
+        http::response<shared_buffer_sequence_body> res;
+        set_common(res);
+        res.set(http::field::content_type, "multipart/byteranges; boundary=" + boundary);
+        res.body().owner = file;
+        res.body().parts.reserve(ranges.size());
+        for (const auto& range : ranges) {
+            std::string prefix = "\r\n--" + boundary + "\r\nContent-Type: " + file->mime_type
+                + "\r\nContent-Range: " + contentRange(range, size) + "\r\n\r\n";
+            res.body().parts.emplace_back(std::move(prefix), content.substr(range.first, range.length()));
+        }
+        res.body().trailer = "\r\n--" + boundary + "--\r\n";
+        res.prepare_payload();
+        send(std::move(res));
+        return true;
+    }
+
+    // Отдаёт запись кэша: тело ответа ссылается на FileHandle, копирования нет.
+    // Представление (br/gzip/identity) выбирается по Accept-Encoding запроса,
+    // при совпадении валидаторов вместо тела уходит 304
+    template<class Request, class Send>
+    void sendCachedFile(const Request& req, const http::response<http::string_body>& base,
+        const FileCache::FileHandle& file, http::status status, Send&& send) {
+        auto accept_field = req[http::field::accept_encoding];
+        auto encoding = FileCache::negotiate_encoding(std::string_view(accept_field.data(), accept_field.size()), *file);
+        const auto& representation = file->representation(encoding);
+        if (status == http::status::ok && isNotModified(req, representation.etag, file->last_modified)) {
+            status = http::status::not_modified;
+        }
+        if (status == http::status::ok && sendCachedRange(req, base, file, encoding, send)) {
+            return;
+        }
+        // HTTP/1.1 — заголовок уже сериализован при загрузке файла, пишем готовые байты
+        if (base.version() == 11) {
+            auto kind = status == http::status::ok ? FileCache::ResponseKind::Ok
+                : status == http::status::not_modified ? FileCache::ResponseKind::NotModified
+                : FileCache::ResponseKind::NotFound;
+            std::string_view body = kind == FileCache::ResponseKind::NotModified ? std::string_view() : representation.content;
+            send(prepared_response{ file, representation.wire_head(kind, base.keep_alive()), body, base.keep_alive() });
+            return;
+        }
+        http::response<shared_buffer_body> res;
+        res.base() = base.base();
+        setDefaultHeaders(res);
+        res.result(status);
+        res.set(http::field::cache_control, file->cache_control());
+        res.set(http::field::etag, representation.etag);
+        res.set(http::field::last_modified, file->last_modified_http);
+        if (status == http::status::not_modified) {
+            if (file->vary_encoding) {
+                res.set(http::field::vary, "Accept-Encoding");
             }
+            send(std::move(res));
+            return;
+        }
+        res.set(http::field::content_type, file->mime_type);
+        if (encoding != FileCache::Encoding::Identity) {
+            res.set(http::field::content_encoding, FileCache::encoding_name(encoding));
+        }
+        if (file->vary_encoding) {
+            res.set(http::field::vary, "Accept-Encoding");
+        }
+        if (status == http::status::ok) {
+            res.set(http::field::accept_ranges, "bytes");
+        }
+        res.body().owner = file;
+        res.body().data = representation.content;
+        res.prepare_payload();
+        send(std::move(res));
+    }
+
+    // Ответ на промах кэша из колбека FileCache::load_file_async — на executor сессии.
+    // false — файл загрузится синхронно, req остаётся у вызывающего
+    template<class Request, class Send>
+    bool sendFileAsync(const std::string& path, Request& req, const http::response<http::string_body>& res, Send& send) {
+        // send объявлен первым и разрушается последним: он держит сессию, а запрос — в её арене
+        struct Pending {
+            std::decay_t<Send> send;
+            Request req;
+            http::response<http::string_body> res;
+        };
+        auto pending = std::make_shared<Pending>(Pending{ send, std::move(req), res });
+        auto executor = send.get_executor();
+        const bool started = file_cache_->load_file_async(path,
+            [executor](std::function<void()> task) { net::post(executor, std::move(task)); },
+            [this, pending](FileCache::FileHandle file) {
+                if (file) {
+                    sendCachedFile(pending->req, pending->res, file, http::status::ok, pending->send);
+                }
+                else {
+                    sendNotFound(pending->req, pending->res, pending->send);  // Файл удалили, пока он читался
+                }
+            });
+        if (!started) {
+            req = std::move(pending->req);
+        }
+        return started;
+    }
+
+    // 404 без обращения к кэшу: заголовок страницы ошибки сериализован заранее (ResponseKind::NotFound)
+    template<class Request, class Send>
+    void sendNotFound(const Request& req, http::response<http::string_body>& res, Send&& send) {
+        res.result(http::status::not_found);
+        FileCache::FileHandle page = file_cache_ ? notFoundPage() : nullptr;
+        if (page) {
+            sendCachedFile(req, res, page, http::status::not_found, send);
+            return;
+        }
+        setDefaultHeaders(res);
+        res.set(http::field::content_type, "text/plain");
+        res.body() = "Not Found";
+        res.prepare_payload();
+        send(std::move(res));
+    }
+
+    // Страница ошибки из static/ со статусом 404 (или текст, если страницы нет)
+    template<class Request, class Send>
+    void sendErrorPage(const Request& req, http::response<http::string_body>& res, const std::string& page_route, Send&& send) {
+        FileCache::FileHandle page;
+        if (file_cache_) {
+            page = file_cache_->get_file(page_route);
+        }
+        if (page) {
+            sendCachedFile(req, res, page, res.result(), send);
+            return;
         }
+        setDefaultHeaders(res);
+        res.set(http::field::content_type, "text/plain");
+        res.body() = "Not Found";
+        res.prepare_payload();
+        send(std::move(res));
     }
 
 protected:
@@ -131,14 +519,6 @@ protected:
     void onShutdown() override;
 
 private:
-    std::vector<std::pair<std::regex,
-        std::function
-        <void(const http::request<http::string_body>&, http::response<http::string_body>&)>
-    >> dynamicRouteHandlers_;
-
-    std::unordered_map<
-        std::string,
-        std::function<void(const http::request<http::string_body>&, http::response<http::string_body>&)>
-    > routeHandlers_;
+    Router router_;
     void setupDefaultRoutes();
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Фильтр Блума по множеству маршрутов. Ответ "нет" точный, "может быть" — с ложными
+// срабатываниями около 1% (10 бит и 7 проб на ключ). Для мусорных путей сканеров это значит:
+// один хэш пути и несколько чтений из массива в пару килобайт, без хэш-таблиц и строковых сравнений.
+class RouteFilter {
+public:
+    explicit RouteFilter(std::size_t expected_keys) {
+        std::size_t bits = 64;
+        while (bits < expected_keys * bits_per_key) {
+            bits <<= 1;
+        }
+        words_.assign(bits / 64, 0);
+        mask_ = bits - 1;
+    }
+
+    void add(std::string_view key) {
+        std::uint64_t h = hash(key);
+        const std::uint64_t step = (h >> 32) | 1;
+        for (int i = 0; i < probes; ++i, h += step) {
+            const std::uint64_t bit = h & mask_;
+            words_[bit >> 6] |= std::uint64_t{ 1 } << (bit & 63);
+        }
+    }
+
+    bool may_contain(std::string_view key) const {
+        std::uint64_t h = hash(key);
+        const std::uint64_t step = (h >> 32) | 1;
+        for (int i = 0; i < probes; ++i, h += step) {
+            const std::uint64_t bit = h & mask_;
+            if ((words_[bit >> 6] & (std::uint64_t{ 1 } << (bit & 63))) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr std::size_t bits_per_key = 10;
+    static constexpr int probes = 7;
+
+    // FNV-1a 64 с перемешиванием (splitmix64): из одного значения берутся обе половины двойного хэширования
+    static std::uint64_t hash(std::string_view key) {
+        std::uint64_t h = 14695981039346656037ull;
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebull;
+        h ^= h >> 31;
+        return h;
+    }
+
+    std::vector<std::uint64_t> words_;
+    std::uint64_t mask_ = 0;
+};
@@ -0,0 +1,259 @@
+﻿#include "Router.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+    // Первый ребёнок с нужным первым символом. Детей не больше, чем различных символов
+    // на этой позиции, — от числа маршрутов просмотр не растёт
+    template<class Children>
+    auto findChild(Children& children, char first) -> decltype(children.front().get()) {
+        for (auto& child : children) {
+            if (child->prefix.front() == first) {
+                return child.get();
+            }
+        }
+        return nullptr;
+    }
+
+    bool parseInt(std::string_view text, int& value) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc() && ptr == text.data() + text.size() && value >= 0;
+    }
+}
+
+std::optional<std::string_view> RouteParams::get(std::string_view name) const {
+    for (std::size_t i = 0; i < count_; ++i) {
+        if (params_[i].name == name) {
+            return params_[i].value;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<int> RouteParams::get_int(std::string_view name) const {
+    for (std::size_t i = 0; i < count_; ++i) {
+        if (params_[i].name == name) {
+            return params_[i].number;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string_view> RouteParams::query(std::string_view name) const {
+    std::string_view rest = query_;
+    while (!rest.empty()) {
+        const std::size_t amp = rest.find('&');
+        std::string_view pair = rest.substr(0, amp);
+        rest = amp == std::string_view::npos ? std::string_view{} : rest.substr(amp + 1);
+        const std::size_t eq = pair.find('=');
+        if (pair.substr(0, eq) == name) {
+            return eq == std::string_view::npos ? std::string_view{} : pair.substr(eq + 1);
+        }
+    }
+    return std::nullopt;
+}
+
+RouteParams RouteParams::rebased(std::string_view from, std::string_view to, const std::vector<std::string>& names) const {
+    auto move = [from, to](std::string_view slice) {
+        return slice.empty() ? std::string_view{} : to.substr(static_cast<std::size_t>(slice.data() - from.data()), slice.size());
+    };
+    RouteParams copy(move(query_));
+    copy.count_ = std::min(count_, names.size());
+    for (std::size_t i = 0; i < copy.count_; ++i) {
+        copy.params_[i] = { names[i], move(params_[i].value), params_[i].number };
+    }
+    return copy;
+}
+
+Router::Router()
+    : root_(std::make_unique<Node>()) {
+}
+
+Router::~Router() = default;
+
+void Router::clear() {
+    root_ = std::make_unique<Node>();
+    routes_ = 0;
+}
+
+std::string_view Router::normalize(std::string_view path) {
+    if (path.size() > 1 && path.back() == '/') {
+        path.remove_suffix(1);
+    }
+    return path;
+}
+
+Router::Node* Router::insert_literal(Node* node, std::string_view text) {
+    while (!text.empty()) {
+        Node* child = findChild(node->children, text.front());
+        if (!child) {
+            auto fresh = std::make_unique<Node>();
+            fresh->prefix = std::string(text);
+            node->children.push_back(std::move(fresh));
+            return node->children.back().get();
+        }
+        const auto mismatch = std::mismatch(child->prefix.begin(), child->prefix.end(), text.begin(), text.end());
+        const std::size_t common = static_cast<std::size_t>(mismatch.first - child->prefix.begin());
+        if (common < child->prefix.size()) {
+            // Ребро расходится посередине: общая часть становится промежуточным узлом
+            auto split = std::make_unique<Node>();
+            split->prefix = child->prefix.substr(0, common);
+            auto it = std::find_if(node->children.begin(), node->children.end(),
+                [child](const std::unique_ptr<Node>& candidate) { return candidate.get() == child; });
+            std::unique_ptr<Node> tail = std::move(*it);
+            tail->prefix.erase(0, common);
+            split->children.push_back(std::move(tail));
+            *it = std::move(split);
+            child = it->get();
+        }
+        node = child;
+        text.remove_prefix(common);
+    }
+    return node;
+}
+
+Router::Endpoint& Router::insert_endpoint(http::verb method, std::string_view pattern, std::vector<std::string>* param_names) {
+    const std::string_view original = pattern;
+    auto invalid = [original](const char* reason) {
+        return std::invalid_argument("Invalid route '" + std::string(original) + "': " + reason);
+    };
+    if (pattern.empty() || pattern.front() != '/') {
+        throw invalid("must start with '/'");
+    }
+    pattern = normalize(pattern);
+
+    Node* node = root_.get();
+    std::size_t params = 0;
+    while (!pattern.empty()) {
+        const std::size_t open = pattern.find('{');
+        node = insert_literal(node, pattern.substr(0, open));
+        if (open == std::string_view::npos) {
+            break;
+        }
+        if (open == 0 || pattern[open - 1] != '/') {
+            throw invalid("a parameter must take a whole segment");
+        }
+        const std::size_t close = pattern.find('}', open);
+        if (close == std::string_view::npos) {
+            throw invalid("unterminated '{'");
+        }
+        if (close + 1 < pattern.size() && pattern[close + 1] != '/') {
+            throw invalid("a parameter must take a whole segment");
+        }
+        if (++params > RouteParams::max_params) {
+            throw invalid("too many parameters");
+        }
+        std::string_view spec = pattern.substr(open + 1, close - open - 1);
+        std::string_view name = spec.substr(0, spec.find(':'));
+        std::string_view type = name.size() < spec.size() ? spec.substr(name.size() + 1) : std::string_view{};
+        if (name.empty()) {
+            throw invalid("unnamed parameter");
+        }
+        ParamType param_type = ParamType::string;
+        if (type == "int") {
+            param_type = ParamType::integer;
+        }
+        else if (!type.empty() && type != "str") {
+            throw invalid("unknown parameter type");
+        }
+        if (!node->param) {
+            node->param = std::make_unique<Node>();
+            node->param->param_name = std::string(name);
+            node->param->param_type = param_type;
+        }
+        else if (node->param->param_name != name || node->param->param_type != param_type) {
+            // Два разных параметра на одной позиции неоднозначны
+            throw invalid("conflicts with another parameter at the same position");
+        }
+        if (param_names) {
+            param_names->emplace_back(name);
+        }
+        node = node->param.get();
+        pattern.remove_prefix(close + 1);
+    }
+
+    for (const auto& endpoint : node->endpoints) {
+        if (endpoint.method == method) {
+            throw invalid("the method is already registered");
+        }
+    }
+    if (method != http::verb::unknown) {  // С обработчиком на любой метод 405 не бывает
+        const auto name = http::to_string(method);
+        node->allow += node->allow.empty() ? "" : ", ";
+        node->allow.append(name.data(), name.size());
+    }
+    ++routes_;
+    return node->endpoints.emplace_back(Endpoint{ method, {}, {} });
+}
+
+void Router::add(http::verb method, std::string_view pattern, Handler handler) {
+    insert_endpoint(method, pattern).handler = std::move(handler);
+}
+
+void Router::add_async(http::verb method, std::string_view pattern, AsyncHandler handler) {
+    auto route = std::make_shared<AsyncRoute>();
+    route->handler = std::move(handler);
+    insert_endpoint(method, pattern, &route->param_names).async_route = std::move(route);
+}
+
+const Router::Node* Router::match(const Node& node, std::string_view path, RouteParams& params) const {
+    if (path.empty()) {
+        return node.endpoints.empty() ? nullptr : &node;
+    }
+    if (const Node* child = findChild(node.children, path.front())) {
+        if (path.substr(0, child->prefix.size()) == child->prefix) {
+            if (const Node* found = match(*child, path.substr(child->prefix.size()), params)) {
+                return found;
+            }
+        }
+    }
+    if (node.param) {
+        const Node& param = *node.param;
+        std::string_view segment = path.substr(0, path.find('/'));
+        int number = 0;
+        if (segment.empty() || (param.param_type == ParamType::integer && !parseInt(segment, number))) {
+            return nullptr;
+        }
+        const std::size_t saved = params.count_;
+        params.params_[params.count_++] = { param.param_name, segment, number };
+        if (const Node* found = match(param, path.substr(segment.size()), params)) {
+            return found;
+        }
+        params.count_ = saved;  // Литеральная ветка глубже не подошла — параметр откатываем
+    }
+    return nullptr;
+}
+
+Router::Match Router::find(http::verb method, std::string_view path, RouteParams& params) const {
+    params.count_ = 0;
+    const Node* node = match(*root_, normalize(path), params);
+    if (!node) {
+        return {};
+    }
+    auto found = [](const Endpoint& endpoint) {
+        if (endpoint.async_route) {
+            return Match{ Status::found, nullptr, endpoint.async_route, {} };
+        }
+        return Match{ Status::found, &endpoint.handler, nullptr, {} };
+    };
+    const Endpoint* any = nullptr;
+    for (const auto& endpoint : node->endpoints) {
+        if (endpoint.method == method) {
+            return found(endpoint);
+        }
+        if (endpoint.method == http::verb::unknown) {
+            any = &endpoint;
+        }
+    }
+    if (any) {
+        return found(*any);
+    }
+    return { Status::method_not_allowed, nullptr, nullptr, node->allow };
+}
+
+bool Router::has_route(std::string_view path) const {
+    RouteParams params;
+    return match(*root_, normalize(path), params) != nullptr;
+}
@@ -0,0 +1,131 @@
+﻿#pragma once
+
+#include <utility>  // awaitable.hpp из Boost 1.74 использует std::exchange, не подключая <utility>
+#include <boost/asio/awaitable.hpp>
+#include <boost/beast/http.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+// Параметры совпавшего маршрута. Значения сегментов {name} и query — срезы target запроса,
+// ничего не копируется; живут, пока жив запрос (то есть на время вызова обработчика)
+class RouteParams {
+public:
+    static constexpr std::size_t max_params = 8;
+
+    RouteParams() = default;
+    explicit RouteParams(std::string_view query)
+        : query_(query) {
+    }
+
+    std::optional<std::string_view> get(std::string_view name) const;
+    // Для сегментов {name:int}: число уже разобрано и проверено при поиске маршрута
+    std::optional<int> get_int(std::string_view name) const;
+
+    // Значение параметра query как есть, без percent-декодирования. ?flag без '=' — пустая строка
+    std::optional<std::string_view> query(std::string_view name) const;
+    std::string_view query_string() const { return query_; }
+
+    // Те же параметры для копии запроса: from — target, по которому искали, to — его копия.
+    // Имена берутся из names (по порядку сегментов шаблона), а не из дерева маршрутов
+    RouteParams rebased(std::string_view from, std::string_view to, const std::vector<std::string>& names) const;
+
+private:
+    friend class Router;
+
+    struct Param {
+        std::string_view name;
+        std::string_view value;
+        int number = 0;
+    };
+
+    std::array<Param, max_params> params_{};
+    std::size_t count_ = 0;
+    std::string_view query_;
+};
+
+// Маршрутизатор API: radix-дерево, которое строится один раз при регистрации маршрутов.
+// Шаблон — литеральные части и параметры во весь сегмент: "/api/employees/{id:int}/penalties".
+// {name} совпадает с любым непустым сегментом, {name:int} — только с неотрицательным int.
+// Поиск идёт по символам пути и от числа маршрутов не зависит; у литерала приоритет перед
+// параметром на той же позиции. Один завершающий '/' в пути игнорируется.
+// Обработчик бывает обычным или корутиной (AsyncHandler): корутина может ждать (co_await)
+// таймеры, чтение файлов, базу, не занимая поток io_context.
+// Регистрировать маршруты можно только до запуска воркеров — потом дерево только читается
+class Router {
+public:
+    using Request = http::request<http::string_body>;
+    using Response = http::response<http::string_body>;
+    using Handler = std::function<void(const Request&, Response&, const RouteParams&)>;
+    // Запрос, ответ и параметры живут до завершения корутины — ссылки можно держать через co_await
+    using AsyncHandler = std::function<net::awaitable<void>(const Request&, Response&, const RouteParams&)>;
+
+    // Корутина переживает вызов find и держит свой маршрут сама (shared_ptr): дерево можно
+    // очистить, пока она ждёт. Поэтому здесь же — свои копии имён параметров
+    struct AsyncRoute {
+        AsyncHandler handler;
+        std::vector<std::string> param_names;  // В порядке сегментов шаблона
+    };
+
+    enum class Status { found, not_found, method_not_allowed };
+    struct Match {
+        Status status = Status::not_found;
+        const Handler* handler = nullptr;             // Ровно один из двух, если status == found
+        std::shared_ptr<const AsyncRoute> async_route;
+        std::string_view allow;  // Для method_not_allowed — значение заголовка Allow
+    };
+
+    Router();
+    ~Router();
+
+    // method == http::verb::unknown — обработчик для любого метода. Некорректный шаблон или
+    // повторная регистрация того же метода — std::invalid_argument
+    void add(http::verb method, std::string_view pattern, Handler handler);
+    // Отдельное имя, а не перегрузка: лямбда-корутина подходит и под Handler (результат отбрасывается)
+    void add_async(http::verb method, std::string_view pattern, AsyncHandler handler);
+
+    Match find(http::verb method, std::string_view path, RouteParams& params) const;
+    // Ведёт ли путь хоть к какому-то маршруту (метод не важен)
+    bool has_route(std::string_view path) const;
+
+    std::size_t size() const { return routes_; }
+    void clear();
+
+private:
+    enum class ParamType { string, integer };
+
+    struct Endpoint {
+        http::verb method;
+        Handler handler;
+        std::shared_ptr<const AsyncRoute> async_route;
+    };
+
+    struct Node {
+        std::string prefix;                           // Сжатое ребро: литералы от родителя до узла
+        std::vector<std::unique_ptr<Node>> children;  // Литеральные продолжения, первые символы различны
+        std::unique_ptr<Node> param;                  // Продолжение сегментом-параметром
+        std::string param_name;                       // Для узла-параметра
+        ParamType param_type = ParamType::string;
+        std::vector<Endpoint> endpoints;              // Маршрут заканчивается здесь
+        std::string allow;                            // Методы endpoints для 405
+    };
+
+    Node* insert_literal(Node* node, std::string_view text);
+    Endpoint& insert_endpoint(http::verb method, std::string_view pattern, std::vector<std::string>* param_names = nullptr);
+    const Node* match(const Node& node, std::string_view path, RouteParams& params) const;
+    static std::string_view normalize(std::string_view path);
+
+    std::unique_ptr<Node> root_;
+    std::size_t routes_ = 0;
+};
@@ -1,10 +1,14 @@
 ﻿#pragma once
 
 #include "RequestHandler.h"
+#include "ConnectionDeadline.h"
 #include "LambdaSenders.h"
+#include "SessionArena.h"
 
 #include <boost/beast/core.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <optional>
 
 namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
@@ -12,16 +16,43 @@ namespace fs = std::filesystem;
 namespace beast = boost::beast;
 namespace http = beast::http;
 
-// UPDATED: Session с shared_ptr для sender lifetime
+// Session владеет всем, что нужно запросу, и переиспользует это между keep-alive запросами:
+// отправитель с колбеком создаются один раз, заголовки запроса и ответы в полёте живут в арене
+// соединения. Установившийся keep-alive запрос к кэшу не обращается к общей куче.
+// Запросы читаются конвейером (HTTP/1.1 pipelining): следующий читается, не дожидаясь ответа
+// на предыдущий, порядок ответов держит отправитель. Уже пришедшие запросы разбираются прямо
+// из буфера, их ответы уходят одной записью.
+// Соединение живёт не дольше, чем позволяют таймауты: простой между запросами, приём
+// заголовка (от первого байта), приём тела и запись без продвижения
 class session : public std::enable_shared_from_this<session> {
 public:
-    session(tcp::socket socket, RequestHandler* module)
-        : socket_(std::move(socket)), module_(module), close_(false) {
+    using fields_type = http::basic_fields<session_allocator<char>>;
+    using request_type = http::request<http::string_body, fields_type>;
+    using sender_type = LambdaSenders::async_send_lambda<tcp::socket>;
+
+    struct Options {
+        std::chrono::seconds idle_timeout{ 60 };    // Ожидание следующего запроса keep-alive
+        std::chrono::seconds header_timeout{ 15 };  // Заголовок целиком после первого байта (slowloris)
+        std::chrono::seconds body_timeout{ 30 };    // Тело запроса после заголовка
+        std::chrono::seconds write_timeout{ 30 };   // Запись ответа без продвижения
+        std::size_t max_requests = 1000;            // Запросов на одно keep-alive соединение
+    };                                              // Ноль везде — без ограничения
+
+    session(tcp::socket socket, RequestHandler* module, const Options& options)
+        : socket_(std::move(socket)), deadline_(socket_.get_executor()), module_(module), options_(options),
+          close_(false), sender_(socket_, close_) {
+        sender_.arena_ = &arena_;
+        sender_.after_write_cb_ = [this](beast::error_code ec) { on_write(ec); };
+        sender_.deadline_ = &deadline_;
+        sender_.write_timeout_ = options_.write_timeout;
+        deadline_.on_expire_ = [this]() { on_timeout(); };
     }
 
     void run() {
+        sender_.owner_ = weak_from_this();
+        deadline_.owner_ = weak_from_this();
         try {
-            do_read();
+            next_request();
         }
         catch (const std::exception& e) {
             std::cerr << "Session run error: " << e.what() << std::endl;
@@ -31,58 +62,210 @@ public:
     }
 
 private:
+    void reset_parser() {
+        // Парсер одноразовый, но живёт в самой сессии: emplace не выделяет памяти, а узлы
+        // заголовков прошлого запроса уже вернулись в арену
+        parser_.emplace(std::piecewise_construct, std::make_tuple(), std::make_tuple(session_allocator<char>(&arena_)));
+    }
+
+    // Разбирает следующий запрос из уже прочитанных байт. false — запроса целиком в буфере нет
+    bool parse_buffered(beast::error_code& ec) {
+        while (buffer_.size() > 0 && !parser_->is_done()) {
+            const std::size_t used = parser_->put(buffer_.data(), ec);
+            buffer_.consume(used);
+            if (ec == http::error::need_more) {
+                ec = {};
+                return false;
+            }
+            if (ec || used == 0) {
+                return false;
+            }
+        }
+        return parser_->is_done();
+    }
+
+    // Запросы, что уже в буфере, обрабатываются сразу. Потом — асинхронное чтение, если
+    // конвейер не заполнен
+    void next_request() {
+        deadline_.stop(connection_deadline::read);
+        if (reading_stopped_) {
+            return;
+        }
+        if (sender_.pipeline_full()) {
+            read_paused_ = true;  // Продолжит on_write, когда уйдёт ответ
+            return;
+        }
+        reset_parser();
+        beast::error_code ec;
+        sender_.cork(true);
+        while (parse_buffered(ec)) {
+            dispatch();
+            if (reading_stopped_ || sender_.pipeline_full()) {
+                break;
+            }
+            reset_parser();
+        }
+        sender_.cork(false);
+        if (ec) {
+            return on_read_error(ec, 0);
+        }
+        if (reading_stopped_) {
+            return;
+        }
+        if (sender_.pipeline_full()) {
+            read_paused_ = true;
+            return;
+        }
+        do_read();
+    }
+
+    // Чтение идёт фазами, у каждой свой таймаут: простой до первого байта запроса,
+    // заголовок, тело
     void do_read() {
-        req_ = {};
-        buffer_.consume(buffer_.size());
-        http::async_read(socket_, buffer_, req_,
+        if (buffer_.size() > 0 || parser_->got_some()) {
+            return read_header();  // Начало запроса уже пришло
+        }
+        // Простой считается, когда клиенту всё отправлено: долгая отдача большого файла
+        // под таймаут простоя не попадает
+        waiting_request_ = true;
+        start_idle_deadline();
+        socket_.async_wait(tcp::socket::wait_read, bind_arena(&arena_,
+            [self = shared_from_this()](beast::error_code ec) {
+                self->waiting_request_ = false;
+                if (ec) {
+                    return self->on_read_error(ec, 0);
+                }
+                self->read_header();
+            }));
+    }
+
+    void start_idle_deadline() {
+        if (sender_.idle()) {
+            deadline_.start(connection_deadline::read, options_.idle_timeout);
+        }
+        else {
+            deadline_.stop(connection_deadline::read);
+        }
+    }
+
+    void read_header() {
+        if (parser_->is_header_done()) {
+            return read_body();
+        }
+        deadline_.start(connection_deadline::read, options_.header_timeout);
+        http::async_read_header(socket_, buffer_, *parser_, bind_arena(&arena_,
+            [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+                if (ec) {
+                    return self->on_read_error(ec, bytes);
+                }
+                self->read_body();
+            }));
+    }
+
+    void read_body() {
+        if (parser_->is_done()) {
+            dispatch();
+            return next_request();
+        }
+        deadline_.start(connection_deadline::read, options_.body_timeout);
+        http::async_read(socket_, buffer_, *parser_, bind_arena(&arena_,
             [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {  // NEW: дебаг байты
                 if (!ec) {
                     //std::cout << "Read " << bytes << " bytes for next request" << std::endl;  // Debug: keep-alive reads
-                    self->on_read();
-                }
-                else if (ec == http::error::end_of_stream) {
-                    //std::cout << "End of stream — closing session" << std::endl;
-                    // Graceful close
-                    beast::error_code sec;
-                    self->socket_.shutdown(net::socket_base::shutdown_both, sec);
+                    self->dispatch();
+                    self->next_request();
                 }
                 else {
-                    std::cerr << "Read error (" << bytes << " bytes): " << ec.message() << std::endl;
-                    beast::error_code sec;
-                    beast::get_lowest_layer(self->socket_).shutdown(net::socket_base::shutdown_both, sec);
+                    self->on_read_error(ec, bytes);
                 }
-            });
+            }));
     }
 
-    void on_read() {
-        // FIXED: make_shared без {} — используем default cb в ctor
-        auto sp_sender = std::make_shared<LambdaSenders::async_send_lambda<tcp::socket>>(socket_, close_);
-        auto sender_ref = std::ref(*sp_sender);  // Ref to deref sp_sender (valid)
+    // Истёк один из таймаутов: закрытие сокета отменяет чтение и запись, сессия уходит
+    // вместе с последним обработчиком
+    void on_timeout() {
+        timed_out_ = true;
+        reading_stopped_ = true;
+        beast::error_code ec;
+        socket_.shutdown(net::socket_base::shutdown_both, ec);
+        socket_.close(ec);
+    }
 
-        // Лямбда для after_write — захват sp_sender (copy shared) + self (no dangling)
-        auto after_write = [self = shared_from_this(), sp_sender](beast::error_code ec) {
-            if (ec == http::error::end_of_stream) {  // NEW: Client closed — normal, no re-read
-                //std::cout << "Client closed connection gracefully" << std::endl;
-                return;
-            }
-            if (!ec && !sp_sender->close_) {
-                self->do_read();  // Keep-alive
-            }
-            else if (ec) {
-                std::cerr << "Post-write error: " << ec.message() << std::endl;
+    void on_read_error(beast::error_code ec, std::size_t bytes) {
+        reading_stopped_ = true;
+        deadline_.stop(connection_deadline::read);
+        if (timed_out_) {
+            return;
+        }
+        if (ec == http::error::end_of_stream) {
+            //std::cout << "End of stream — closing session" << std::endl;
+            // Graceful close. Клиент мог закрыть свою сторону, отправив запросы конвейером, —
+            // тогда ответы дописываются, а сокет закроется вместе с сессией
+            if (sender_.idle()) {
+                beast::error_code sec;
+                socket_.shutdown(net::socket_base::shutdown_both, sec);
             }
-            };
+            return;
+        }
+        std::cerr << "Read error (" << bytes << " bytes): " << ec.message() << std::endl;
+        beast::error_code sec;
+        beast::get_lowest_layer(socket_).shutdown(net::socket_base::shutdown_both, sec);
+    }
 
-        // FIXED: Set cb ПОСЛЕ создания sp_sender, но ДО handleRequest
-        sp_sender->after_write_cb_ = after_write;
+    void dispatch() {
+        req_ = parser_->release();
+        if (close_) {
+            reading_stopped_ = true;  // Уже отвечаем с закрытием соединения — запрос опоздал
+            return;
+        }
+        if (options_.max_requests > 0 && ++requests_ >= options_.max_requests) {
+            req_.keep_alive(false);  // Последний запрос соединения: ответ уйдёт с Connection: close
+        }
+        if (!req_.keep_alive()) {
+            reading_stopped_ = true;  // Ответ на этот запрос закроет соединение
+        }
+        // Отправитель передаётся копируемым: обработчик может ответить и позже, из колбека.
+        // Алиасный shared_ptr на член сессии — без выделения памяти
+        module_->handleRequest(std::move(req_),
+            LambdaSenders::shared_send_lambda<tcp::socket>{ std::shared_ptr<sender_type>(shared_from_this(), &sender_), sender_.begin_slot() });
+        if (close_) {
+            reading_stopped_ = true;
+        }
+    }
 
-        // Теперь handleRequest: sender живёт via sp, ref ok
-        module_->handleRequest(std::move(req_), sender_ref);
+    void on_write(beast::error_code ec) {
+        if (ec == http::error::end_of_stream) {  // NEW: Client closed — normal, no re-read
+            //std::cout << "Client closed connection gracefully" << std::endl;
+            return;
+        }
+        if (ec) {
+            if (!timed_out_) {
+                std::cerr << "Post-write error: " << ec.message() << std::endl;
+            }
+            return;
+        }
+        if (waiting_request_) {
+            start_idle_deadline();
+        }
+        if (read_paused_ && !sender_.pipeline_full()) {
+            read_paused_ = false;
+            next_request();  // Keep-alive
+        }
     }
 
+    session_arena arena_;  // Объявлена первой: всё, что ниже, возвращает в неё память при разрушении
     tcp::socket socket_;
+    connection_deadline deadline_;
     beast::flat_buffer buffer_;
-    http::request<http::string_body> req_;
+    std::optional<http::request_parser<http::string_body, session_allocator<char>>> parser_;
+    request_type req_;
     RequestHandler* module_;
+    Options options_;
     bool close_;  // Member ok
-};
\ No newline at end of file
+    bool reading_stopped_ = false;  // Больше запросов не будет: close или конец потока
+    bool read_paused_ = false;      // Конвейер заполнен, чтение ждёт ответов
+    bool waiting_request_ = false;  // Ждём первый байт следующего запроса
+    bool timed_out_ = false;
+    std::size_t requests_ = 0;
+    sender_type sender_;
+};
@@ -0,0 +1,147 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Память одного соединения для того, что пересоздаётся на каждый запрос: узлы заголовков запроса
+// (http::basic_fields), ответы, пока они пишутся в сокет. Освобождённый блок ложится в список
+// своего класса размера и достаётся следующему запросу, поэтому keep-alive соединение после
+// первых запросов в общую кучу не ходит. Крупные и сверхвыровненные блоки — напрямую в operator new.
+// Не потокобезопасна: всё, что её использует, живёт на strand (или в потоке шарда) сессии
+class session_arena {
+public:
+    session_arena() = default;
+    session_arena(const session_arena&) = delete;
+    session_arena& operator=(const session_arena&) = delete;
+
+    ~session_arena() {
+        for (int index = 0; index < class_count; ++index) {
+            while (free_[index]) {
+                free_block* next = free_[index]->next;
+                ::operator delete(free_[index], block_size(index));
+                free_[index] = next;
+            }
+        }
+    }
+
+    void* allocate(std::size_t bytes, std::size_t alignment) {
+        const int index = class_index(bytes, alignment);
+        if (index < 0) {
+            return ::operator new(bytes, std::align_val_t(alignment));
+        }
+        if (free_block* block = free_[index]) {
+            free_[index] = block->next;
+            return block;
+        }
+        return ::operator new(block_size(index));
+    }
+
+    void deallocate(void* pointer, std::size_t bytes, std::size_t alignment) noexcept {
+        const int index = class_index(bytes, alignment);
+        if (index < 0) {
+            ::operator delete(pointer, bytes, std::align_val_t(alignment));
+            return;
+        }
+        auto* block = static_cast<free_block*>(pointer);
+        block->next = free_[index];
+        free_[index] = block;
+    }
+
+private:
+    struct free_block {
+        free_block* next;
+    };
+
+    // Классы 32, 64, ..., 4096 байт: заголовок запроса браузера — десяток-другой узлов по 64–256 байт
+    static constexpr int class_count = 8;
+    static constexpr std::size_t min_block = 32;
+
+    static constexpr std::size_t block_size(int index) {
+        return min_block << index;
+    }
+
+    static int class_index(std::size_t bytes, std::size_t alignment) {
+        if (alignment > alignof(std::max_align_t)) {
+            return -1;
+        }
+        for (int index = 0; index < class_count; ++index) {
+            if (bytes <= block_size(index)) {
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    free_block* free_[class_count] = {};
+};
+
+// Аллокатор поверх session_arena для http::basic_fields и std::allocate_shared.
+// Без арены (по умолчанию сконструированный) работает как std::allocator
+template<class T>
+class session_allocator {
+public:
+    using value_type = T;
+    // Запрос переезжает между сообщениями вместе со своей памятью
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    session_allocator() noexcept = default;
+    explicit session_allocator(session_arena* arena) noexcept
+        : arena_(arena) {
+    }
+    template<class U>
+    session_allocator(const session_allocator<U>& other) noexcept
+        : arena_(other.arena()) {
+    }
+
+    T* allocate(std::size_t n) {
+        if (!arena_) {
+            return std::allocator<T>{}.allocate(n);
+        }
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* pointer, std::size_t n) noexcept {
+        if (!arena_) {
+            std::allocator<T>{}.deallocate(pointer, n);
+            return;
+        }
+        arena_->deallocate(pointer, n * sizeof(T), alignof(T));
+    }
+
+    session_arena* arena() const noexcept { return arena_; }
+
+    template<class U>
+    friend bool operator==(const session_allocator& lhs, const session_allocator<U>& rhs) noexcept {
+        return lhs.arena_ == rhs.arena();
+    }
+
+private:
+    session_arena* arena_ = nullptr;
+};
+
+// Обработчик асинхронной операции сессии: Asio берёт память под состояние операции
+// через связанный аллокатор (associated_allocator), то есть из арены, а не из кучи
+template<class Handler>
+struct arena_handler {
+    using allocator_type = session_allocator<void>;
+
+    session_arena* arena;
+    Handler handler;
+
+    allocator_type get_allocator() const noexcept { return allocator_type(arena); }
+
+    template<class... Args>
+    void operator()(Args&&... args) {
+        handler(std::forward<Args>(args)...);
+    }
+};
+
+template<class Handler>
+arena_handler<std::decay_t<Handler>> bind_arena(session_arena* arena, Handler&& handler) {
+    return { arena, std::forward<Handler>(handler) };
+}
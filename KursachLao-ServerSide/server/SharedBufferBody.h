@@ -0,0 +1,106 @@
+﻿#pragma once
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+
+// Тело ответа, которое ссылается на неизменяемый буфер (например, запись FileCache)
+// вместо того чтобы копировать его в std::string. owner держит данные живыми,
+// пока ответ не будет записан в сокет.
+struct shared_buffer_body {
+    struct value_type {
+        std::shared_ptr<const void> owner;
+        std::string_view data;
+    };
+
+    static std::uint64_t size(const value_type& body) {
+        return body.data.size();
+    }
+
+    class writer {
+        const value_type& body_;
+
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template<bool isRequest, class Fields>
+        explicit writer(const http::header<isRequest, Fields>&, const value_type& body)
+            : body_(body) {
+        }
+
+        void init(beast::error_code& ec) {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            return { { const_buffers_type(body_.data.data(), body_.data.size()), false } };
+        }
+    };
+};
+
+// Тело из нескольких частей: перед каждым срезом буфера owner идёт собственный префикс
+// (заголовки части multipart), в конце — trailer. Используется для multipart/byteranges,
+// срезы файла при этом не копируются.
+struct shared_buffer_sequence_body {
+    struct value_type {
+        std::shared_ptr<const void> owner;
+        std::vector<std::pair<std::string, std::string_view>> parts;  // (префикс, срез данных)
+        std::string trailer;
+    };
+
+    static std::uint64_t size(const value_type& body) {
+        std::uint64_t total = body.trailer.size();
+        for (const auto& [prefix, slice] : body.parts) {
+            total += prefix.size() + slice.size();
+        }
+        return total;
+    }
+
+    class writer {
+        const value_type& body_;
+        std::size_t step_ = 0;  // 2 шага на часть (префикс, срез) + trailer
+
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template<bool isRequest, class Fields>
+        explicit writer(const http::header<isRequest, Fields>&, const value_type& body)
+            : body_(body) {
+        }
+
+        void init(beast::error_code& ec) {
+            ec = {};
+            step_ = 0;
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            const std::size_t total_steps = body_.parts.size() * 2 + 1;
+            if (step_ >= total_steps) {
+                return boost::none;
+            }
+            const std::size_t current = step_++;
+            const bool more = step_ < total_steps;
+            if (current == total_steps - 1) {
+                return { { const_buffers_type(body_.trailer.data(), body_.trailer.size()), more } };
+            }
+            const auto& part = body_.parts[current / 2];
+            if (current % 2 == 0) {
+                return { { const_buffers_type(part.first.data(), part.first.size()), more } };
+            }
+            return { { const_buffers_type(part.second.data(), part.second.size()), more } };
+        }
+    };
+};
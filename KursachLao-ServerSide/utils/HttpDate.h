@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Форматирование и разбор HTTP-дат (IMF-fixdate, RFC 9110):
+// "Sun, 06 Nov 1994 08:49:37 GMT". Без timegm/_mkgmtime — через календарную арифметику,
+// чтобы одинаково работало на Linux и Windows.
+namespace http_date {
+
+    namespace detail {
+        // Количество дней от 1970-01-01 до даты (алгоритм days_from_civil, Howard Hinnant)
+        inline long long days_from_civil(long long y, unsigned m, unsigned d) {
+            y -= m <= 2;
+            const long long era = (y >= 0 ? y : y - 399) / 400;
+            const unsigned yoe = static_cast<unsigned>(y - era * 400);
+            const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+            const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+            return era * 146097 + static_cast<long long>(doe) - 719468;
+        }
+
+        inline void civil_from_days(long long z, long long& y, unsigned& m, unsigned& d) {
+            z += 719468;
+            const long long era = (z >= 0 ? z : z - 146096) / 146097;
+            const unsigned doe = static_cast<unsigned>(z - era * 146097);
+            const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+            y = static_cast<long long>(yoe) + era * 400;
+            const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+            const unsigned mp = (5 * doy + 2) / 153;
+            d = doy - (153 * mp + 2) / 5 + 1;
+            m = mp + (mp < 10 ? 3 : -9);
+            y += m <= 2;
+        }
+
+        constexpr const char* kDays[] = { "Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed" };  // 1970-01-01 — четверг
+        constexpr const char* kMonths[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                            "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    }
+
+    inline std::string format(std::chrono::system_clock::time_point tp) {
+        using namespace std::chrono;
+        long long secs = duration_cast<seconds>(tp.time_since_epoch()).count();
+        long long days = secs >= 0 ? secs / 86400 : (secs - 86399) / 86400;
+        long long rem = secs - days * 86400;
+        long long y;
+        unsigned m, d;
+        detail::civil_from_days(days, y, m, d);
+        long long wd = days % 7;
+        if (wd < 0) wd += 7;
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%s, %02u %s %04lld %02lld:%02lld:%02lld GMT",
+            detail::kDays[wd], d, detail::kMonths[m - 1], y, rem / 3600, (rem / 60) % 60, rem % 60);
+        return buf;
+    }
+
+    inline std::optional<std::chrono::system_clock::time_point> parse(std::string_view value) {
+        // Ожидаем ровно IMF-fixdate; устаревшие форматы (RFC 850, asctime) браузеры не шлют
+        if (value.size() < 29 || value[3] != ',' || value.substr(value.size() - 3) != "GMT") {
+            return std::nullopt;
+        }
+        char month[4] = {};
+        unsigned d = 0, hh = 0, mm = 0, ss = 0;
+        long long y = 0;
+        std::string text(value);
+        if (std::sscanf(text.c_str() + 5, "%2u %3s %4lld %2u:%2u:%2u", &d, month, &y, &hh, &mm, &ss) != 6) {
+            return std::nullopt;
+        }
+        unsigned m = 0;
+        for (unsigned i = 0; i < 12; ++i) {
+            if (std::string_view(month) == detail::kMonths[i]) {
+                m = i + 1;
+                break;
+            }
+        }
+        if (m == 0 || d == 0 || d > 31 || hh > 23 || mm > 59 || ss > 60) {
+            return std::nullopt;
+        }
+        long long secs = detail::days_from_civil(y, m, d) * 86400 + hh * 3600 + mm * 60 + ss;
+        return std::chrono::system_clock::time_point(std::chrono::seconds(secs));
+    }
+
+}
@@ -3,10 +3,13 @@
 //Всё это - временное решение навайбкоженное за 3 минуты
 #pragma once
 
+#include "EmbeddedStatic.h"
+
 #include <boost/program_options.hpp>
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <thread>
 
 namespace fs = std::filesystem;
 namespace po = boost::program_options;
@@ -15,6 +18,31 @@ struct ServerConfig {
     std::string address = "0.0.0.0";
     int         port = 8080;
     std::string directory = "static";
+    bool        embedded = embedded_static::compiled_in;  // Раздавать статику, вшитую в бинарник, а не directory
+    int         threads = 1;   // Количество воркеров io_context
+    int         shards = 0;    // > 0 — режим шардов: свой акцептор (SO_REUSEPORT), io_context и поток на ядро
+    bool        log_connections = false;
+    int         idle_timeout = 60;     // Секунды простоя keep-alive соединения между запросами (0 — без ограничения)
+    int         header_timeout = 15;   // Секунды на заголовок запроса после первого байта
+    int         body_timeout = 30;     // Секунды на тело запроса
+    int         write_timeout = 30;    // Секунды записи ответа без продвижения
+    std::size_t max_keepalive_requests = 1000;  // Запросов на соединение, после — Connection: close (0 — без ограничения)
+    bool        compress = true;  // gzip/brotli-варианты текстовой статики в кэше
+    bool        fingerprint = false;  // Маршруты с хэшем содержимого (immutable) и подмена ссылок в HTML
+    std::size_t sendfile_threshold = 256 * 1024;  // Файлы от этого размера отдаются с диска без копирования (0 — выключено)
+    std::size_t cache_size = 64 * 1024 * 1024;  // Бюджет памяти FileCache в байтах
+    std::size_t mmap_threshold = 1024 * 1024;   // Файлы от этого размера кэшируются через mmap, мимо бюджета кучи (0 — выключено; с watch всегда выключено)
+    std::size_t cache_max_file = 0;             // Файлы крупнее в кэш не попадают (0 — без ограничения)
+    bool        io_uring = false;  // Читать файлы при промахе кэша через io_uring, не блокируя воркеры (Linux)
+    bool        watch = true;  // Следить за изменениями в directory (inotify / опрос) и обновлять кэш
+    bool        warmup = true;                  // Загрузить статику в кэш до приёма соединений
+    std::string warmup_pattern = "*";           // Какие маршруты прогревать (glob)
+    bool        warmup_background = false;      // Прогревать в фоне, не откладывая старт
+    int         db_threads = 4;                 // Потоки DatabaseExecutor: транзакции pqxx идут на них, а не на воркерах io_context
+    std::size_t db_pool_min = 1;                // Соединений с базой открыто всегда
+    std::size_t db_pool_max = 4;                // Предел соединений; больше db_threads смысла нет
+    int         db_acquire_timeout = 2000;      // Мс ожидания свободного соединения, потом 503
+    std::size_t db_queue = 256;                 // Задач к базе в очереди, дальше — 503 (0 — без ограничения)
 
     // Метод для парсинга и валидации аргументов
     static ServerConfig parse(int argc, char* argv[]) {
@@ -28,7 +56,58 @@ struct ServerConfig {
             ("port,p", po::value<int>(&config.port)->default_value(8080),
                 "Port to listen on")
             ("directory,d", po::value<std::string>(&config.directory)->default_value("static"),
-                "Path to static files directory");
+                "Path to static files directory")
+            ("embedded", po::value<bool>(&config.embedded)->default_value(embedded_static::compiled_in),
+                "Serve the static files compiled into the binary (build with -DKURSACH_EMBED_STATIC=ON) instead of reading the directory")
+            ("threads,t", po::value<int>(&config.threads)->default_value(defaultThreads()),
+                "Number of io_context worker threads")
+            ("shards,s", po::value<int>(&config.shards)->default_value(0),
+                "Shard-per-core mode: N acceptors with SO_REUSEPORT, each with its own io_context and pinned thread (0 = shared pool)")
+            ("log-connections", po::bool_switch(&config.log_connections),
+                "Log every accepted connection")
+            ("idle-timeout", po::value<int>(&config.idle_timeout)->default_value(60),
+                "Close a keep-alive connection after this many seconds without a new request (0 = never)")
+            ("header-timeout", po::value<int>(&config.header_timeout)->default_value(15),
+                "Seconds a client has to send the request header once it started (0 = unlimited)")
+            ("body-timeout", po::value<int>(&config.body_timeout)->default_value(30),
+                "Seconds a client has to send the request body (0 = unlimited)")
+            ("write-timeout", po::value<int>(&config.write_timeout)->default_value(30),
+                "Close the connection if writing a response makes no progress for this many seconds (0 = unlimited)")
+            ("max-keepalive-requests", po::value<std::size_t>(&config.max_keepalive_requests)->default_value(1000),
+                "Requests served on one connection before it is closed (0 = unlimited)")
+            ("compress", po::value<bool>(&config.compress)->default_value(true),
+                "Serve precompressed gzip/brotli variants of text assets (Accept-Encoding negotiation)")
+            ("fingerprint", po::bool_switch(&config.fingerprint),
+                "Publish content-hashed routes for assets (/modules/dataCache.<hash>.js, Cache-Control: immutable) and rewrite src/href in HTML to them")
+            ("sendfile-threshold", po::value<std::size_t>(&config.sendfile_threshold)->default_value(256 * 1024),
+                "Serve files of at least this many bytes with zero-copy file_body/sendfile (0 = always use the cache)")
+            ("cache-size", po::value<std::size_t>(&config.cache_size)->default_value(64 * 1024 * 1024),
+                "Memory budget of the static file cache in bytes (LRU eviction)")
+            ("mmap-threshold", po::value<std::size_t>(&config.mmap_threshold)->default_value(1024 * 1024),
+                "Memory-map cached files of at least this many bytes instead of copying them to the heap (0 = off). "
+                "Ignored with --watch: a file rewritten in place under a mapping would crash the server with SIGBUS")
+            ("cache-max-file", po::value<std::size_t>(&config.cache_max_file)->default_value(0),
+                "Files larger than this many bytes bypass the cache (0 = no limit)")
+            ("io-uring", po::bool_switch(&config.io_uring),
+                "Read files on cache misses through io_uring (Linux 5.6+) so that cold reads never block the io threads")
+            ("watch", po::value<bool>(&config.watch)->default_value(true),
+                "Watch the static directory (inotify, polling elsewhere) and update the cache on changes")
+            ("warmup", po::value<bool>(&config.warmup)->default_value(true),
+                "Load static files into the cache in parallel at startup, until the cache budget is used up")
+            ("warmup-pattern", po::value<std::string>(&config.warmup_pattern)->default_value("*"),
+                "Glob of routes to warm up ('*' matches any substring, '?' one character), e.g. \"/assets/*\"")
+            ("warmup-background", po::bool_switch(&config.warmup_background),
+                "Start accepting connections immediately and warm up the cache in the background")
+            ("db-threads", po::value<int>(&config.db_threads)->default_value(4),
+                "Threads that run blocking database work, separate from the io_context workers")
+            ("db-pool-min", po::value<std::size_t>(&config.db_pool_min)->default_value(1),
+                "Database connections kept open at all times")
+            ("db-pool-max", po::value<std::size_t>(&config.db_pool_max)->default_value(4),
+                "Upper limit of database connections (more than db-threads is never used)")
+            ("db-acquire-timeout", po::value<int>(&config.db_acquire_timeout)->default_value(2000),
+                "Milliseconds to wait for a free database connection before answering 503")
+            ("db-queue", po::value<std::size_t>(&config.db_queue)->default_value(256),
+                "Database tasks allowed to wait for a thread; further API requests get 503 (0 = unlimited)");
 
         po::variables_map vm;
         try {
@@ -46,8 +125,48 @@ struct ServerConfig {
                 std::exit(EXIT_FAILURE);
             }
 
+            // Валидация числа потоков
+            if (config.threads <= 0) {
+                std::cerr << "Error: threads must be a positive number\n";
+                std::exit(EXIT_FAILURE);
+            }
+
+            if (config.db_threads <= 0) {
+                std::cerr << "Error: db-threads must be a positive number\n";
+                std::exit(EXIT_FAILURE);
+            }
+
+            if (config.db_pool_max == 0 || config.db_pool_min > config.db_pool_max || config.db_acquire_timeout < 0) {
+                std::cerr << "Error: db-pool-max must be positive and not less than db-pool-min, db-acquire-timeout not negative\n";
+                std::exit(EXIT_FAILURE);
+            }
+
+            if (config.idle_timeout < 0 || config.header_timeout < 0 || config.body_timeout < 0 || config.write_timeout < 0) {
+                std::cerr << "Error: timeouts must not be negative\n";
+                std::exit(EXIT_FAILURE);
+            }
+
+            if (config.shards < 0) {
+                std::cerr << "Error: shards must not be negative\n";
+                std::exit(EXIT_FAILURE);
+            }
+
+            // Правка на месте обрезает файл под отображением, и чтение за новым концом даёт SIGBUS.
+            // С наблюдателем файлы меняются на лету, поэтому большие файлы читаются в кучу
+            if (config.watch && !config.embedded && config.mmap_threshold > 0) {
+                if (!vm["mmap-threshold"].defaulted()) {
+                    std::cerr << "Warning: mmap-threshold is ignored while the directory is watched (--watch false enables it)\n";
+                }
+                config.mmap_threshold = 0;
+            }
+
+            if (config.embedded && !embedded_static::compiled_in) {
+                std::cerr << "Error: this build has no embedded static files (rebuild with -DKURSACH_EMBED_STATIC=ON)\n";
+                std::exit(EXIT_FAILURE);
+            }
+
             // Проверка существования директории (не критично, только предупреждение)
-            if (!fs::exists(config.directory)) {
+            if (!config.embedded && !fs::exists(config.directory)) {
                 std::cerr << "Warning: directory '" << config.directory << "' does not exist\n";
             }
         }
@@ -61,8 +180,33 @@ struct ServerConfig {
         std::cout << "Server configuration:\n"
             << " Address: " << config.address << "\n"
             << " Port: " << config.port << "\n"
-            << " Directory: " << config.directory << "\n\n";
+            << " Directory: " << config.directory << (config.embedded ? " (embedded in binary)" : "") << "\n"
+            << " Threads: " << config.threads << "\n"
+            << " Timeouts (idle/header/body/write): " << config.idle_timeout << "/" << config.header_timeout << "/"
+            << config.body_timeout << "/" << config.write_timeout << " s\n"
+            << " Max requests per connection: " << (config.max_keepalive_requests > 0 ? std::to_string(config.max_keepalive_requests) : "unlimited") << "\n"
+            << " Compression: " << (config.compress ? "on" : "off") << "\n"
+            << " Asset fingerprinting: " << (config.fingerprint ? "on" : "off") << "\n"
+            << " Sendfile threshold: " << config.sendfile_threshold << " bytes\n"
+            << " Cache: " << config.cache_size << " bytes"
+            << (config.cache_max_file > 0 ? ", files up to " + std::to_string(config.cache_max_file) + " bytes" : std::string()) << "\n"
+            << " Mmap threshold: " << (config.mmap_threshold > 0 ? std::to_string(config.mmap_threshold) + " bytes" : "off") << "\n"
+            << " io_uring reads: " << (config.io_uring ? "on" : "off") << "\n"
+            << " Watch directory: " << (config.watch && !config.embedded ? "on" : "off") << "\n"
+            << " Cache warm-up: " << (config.warmup ? config.warmup_pattern + (config.warmup_background ? " (background)" : "") : "off") << "\n"
+            << " Database threads: " << config.db_threads << ", queue "
+            << (config.db_queue > 0 ? std::to_string(config.db_queue) : "unlimited") << "\n"
+            << " Database pool: " << config.db_pool_min << "-" << config.db_pool_max << " connections, acquire timeout "
+            << config.db_acquire_timeout << " ms\n"
+            << " Shards: " << (config.shards > 0 ? std::to_string(config.shards) : "off") << "\n\n";
 
         return config;
     }
+
+private:
+    // По умолчанию — по одному воркеру на ядро
+    static int defaultThreads() {
+        unsigned int hc = std::thread::hardware_concurrency();
+        return hc > 0 ? static_cast<int>(hc) : 1;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,113 @@
+﻿#pragma once
+
+#include "StringHash.h"
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Отображение string -> Value для снимков с копированием при записи. Ключи разложены по Shards
+// шардам по хэшу, шарды общие у копий: копия стоит Shards указателей, а первое изменение
+// шарда в копии копирует только его. Правка одного ключа не зависит от размера всего отображения.
+// Копию меняет один поток (писатель), опубликованную — только читают
+template<class Value, std::size_t Shards = 64>
+class ShardedStringMap {
+    static_assert(Shards > 1 && (Shards & (Shards - 1)) == 0, "Shards must be a power of two greater than 1");
+
+public:
+    ShardedStringMap() = default;
+    // Шарды общие с оригиналом: свои появятся при первой правке
+    ShardedStringMap(const ShardedStringMap& other)
+        : shards_(other.shards_), size_(other.size_) {
+    }
+    ShardedStringMap& operator=(const ShardedStringMap&) = delete;
+
+    // nullptr — ключа нет
+    const Value* find(std::string_view key) const {
+        const auto& shard = shards_[shard_of(key)];
+        if (!shard) {
+            return nullptr;
+        }
+        auto it = shard->find(key);
+        return it == shard->end() ? nullptr : &it->second;
+    }
+
+    // Вставка или замена
+    void insert_or_assign(const std::string& key, Value value) {
+        auto& shard = own(shard_of(key));
+        auto [it, inserted] = shard.insert_or_assign(key, std::move(value));
+        size_ += inserted ? 1 : 0;
+    }
+
+    bool erase(std::string_view key) {
+        const std::size_t index = shard_of(key);
+        if (!shards_[index] || shards_[index]->find(key) == shards_[index]->end()) {
+            return false;  // Чужой шард не копируем, если менять в нём нечего
+        }
+        auto& shard = own(index);
+        shard.erase(shard.find(key));
+        --size_;
+        return true;
+    }
+
+    // f(const std::string& key, const Value& value)
+    template<class F>
+    void for_each(F&& f) const {
+        for (const auto& shard : shards_) {
+            if (!shard) {
+                continue;
+            }
+            for (const auto& [key, value] : *shard) {
+                f(key, value);
+            }
+        }
+    }
+
+    // Ключи, для которых pred(key, value) — true. Удалять по ним можно уже после обхода
+    template<class Pred>
+    std::vector<std::string> keys_if(Pred&& pred) const {
+        std::vector<std::string> keys;
+        for_each([&](const std::string& key, const Value& value) {
+            if (pred(key, value)) {
+                keys.push_back(key);
+            }
+        });
+        return keys;
+    }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    using Shard = StringMap<Value>;
+
+    static std::size_t shard_of(std::string_view key) {
+        // Старшие биты после умножения: младшие биты того же хэша выбирают корзину внутри шарда
+        const std::uint64_t hash = static_cast<std::uint64_t>(StringHash{}(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<std::size_t>(hash >> (64 - shard_bits()));
+    }
+    static constexpr unsigned shard_bits() {
+        unsigned bits = 0;
+        while ((std::size_t{ 1 } << bits) < Shards) {
+            ++bits;
+        }
+        return bits;
+    }
+
+    Shard& own(std::size_t index) {
+        if (!owned_[index]) {
+            shards_[index] = shards_[index] ? std::make_shared<Shard>(*shards_[index]) : std::make_shared<Shard>();
+            owned_[index] = true;
+        }
+        return *shards_[index];
+    }
+
+    std::array<std::shared_ptr<Shard>, Shards> shards_{};
+    std::bitset<Shards> owned_;  // Шард создан этой копией и больше ни с кем не разделён
+    std::size_t size_ = 0;
+};
@@ -0,0 +1,20 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Прозрачный хэш: unordered_map<std::string, ...> с ним ищет по string_view (и строковому литералу)
+// без временной std::string — путь из запроса так и остаётся срезом буфера соединения
+struct StringHash {
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view key) const noexcept {
+        return std::hash<std::string_view>{}(key);
+    }
+};
+
+template<class Value>
+using StringMap = std::unordered_map<std::string, Value, StringHash, std::equal_to<>>;
@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include <iostream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Привязка текущего потока к ядру. Используется в режиме шардов, чтобы
+// io_context шарда и его соединения не мигрировали между ядрами.
+// На платформах без pthread_setaffinity_np — no-op.
+inline bool pinCurrentThreadToCore(unsigned int core) {
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core % CPU_SETSIZE, &cpuset);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    if (rc != 0) {
+        std::cerr << "Failed to pin thread to core " << core << " (error " << rc << ")" << std::endl;
+        return false;
+    }
+    return true;
+#else
+    (void)core;
+    return false;
+#endif
+}
@@ -0,0 +1,228 @@
+﻿// Генератор embedded_static.cpp: превращает каталог static в constexpr-массивы байтов
+// и таблицу идеального хэширования (CHD: корзина -> смещение -> слот) по относительным путям.
+// Запускается из CMake при KURSACH_EMBED_STATIC: embed_static <static_dir> <output.cpp>
+#include "EmbeddedStatic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+    struct SourceFile {
+        std::string path;  // Относительный, через '/'
+        std::string content;
+        std::int64_t mtime = 0;
+    };
+
+    std::int64_t to_unix_seconds(fs::file_time_type ftime) {
+        auto system_time = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+            ftime - fs::file_time_type::clock::now() + std::chrono::system_clock::now());
+        return std::chrono::duration_cast<std::chrono::seconds>(system_time.time_since_epoch()).count();
+    }
+
+    bool read_file(const fs::path& file_path, std::string& content) {
+        std::ifstream file(file_path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return !file.bad();
+    }
+
+    // Строковый литерал C++: всё, кроме печатного ASCII, — восьмеричными escape-последовательностями
+    std::string cpp_literal(std::string_view text) {
+        std::string literal = "\"";
+        for (unsigned char c : text) {
+            if (c == '"' || c == '\\') {
+                literal += '\\';
+                literal += static_cast<char>(c);
+            }
+            else if (c >= 0x20 && c < 0x7f && c != '?') {
+                literal += static_cast<char>(c);
+            }
+            else {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\%03o", c);
+                literal += escaped;
+            }
+        }
+        literal += '"';
+        return literal;
+    }
+
+    // Для каждой корзины подбираем смещение, при котором все её ключи попадают в свободные
+    // и разные слоты. Корзины разбираются от больших к маленьким — так поиск сходится быстро
+    bool build_perfect_hash(const std::vector<SourceFile>& files,
+        std::vector<std::uint32_t>& displacements, std::vector<std::uint32_t>& slots) {
+        const std::size_t count = files.size();
+        const std::size_t bucket_count = std::max<std::size_t>(1, (count + 3) / 4);
+        std::vector<std::vector<std::uint32_t>> buckets(bucket_count);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            buckets[embedded_static::hash(files[i].path, 0) % bucket_count].push_back(i);
+        }
+        std::vector<std::size_t> order(bucket_count);
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) {
+            return buckets[lhs].size() > buckets[rhs].size();
+        });
+
+        displacements.assign(bucket_count, 0);
+        slots.assign(count, 0);
+        std::vector<bool> taken(count, false);
+        std::vector<std::size_t> candidate;
+        for (std::size_t bucket : order) {
+            if (buckets[bucket].empty()) {
+                break;
+            }
+            bool placed = false;
+            for (std::uint32_t displacement = 1; displacement < 10'000'000 && !placed; ++displacement) {
+                candidate.clear();
+                placed = true;
+                for (std::uint32_t key : buckets[bucket]) {
+                    std::size_t slot = embedded_static::hash(files[key].path, displacement) % count;
+                    if (taken[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+                        placed = false;
+                        break;
+                    }
+                    candidate.push_back(slot);
+                }
+                if (placed) {
+                    displacements[bucket] = displacement;
+                    for (std::size_t i = 0; i < candidate.size(); ++i) {
+                        taken[candidate[i]] = true;
+                        slots[candidate[i]] = buckets[bucket][i];
+                    }
+                }
+            }
+            if (!placed) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string generate(const fs::path& static_dir, const std::vector<SourceFile>& files,
+        const std::vector<std::uint32_t>& displacements, const std::vector<std::uint32_t>& slots) {
+        std::ostringstream out;
+        // BOM — как у остальных исходников, чтобы MSVC читал комментарии как UTF-8
+        out << "\xEF\xBB\xBF// Сгенерировано tools/embed_static из " << static_dir.generic_string() << ". Не редактировать.\n"
+            << "#include \"EmbeddedStatic.h\"\n\n"
+            << "#include <iterator>\n\n"
+            << "namespace embedded_static {\n\n";
+        if (files.empty()) {
+            out << "    std::span<const Asset> assets() {\n        return {};\n    }\n\n"
+                << "    const Asset* find(std::string_view) {\n        return nullptr;\n    }\n\n}\n";
+            return out.str();
+        }
+
+        out << "namespace {\n";
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            const auto& content = files[i].content;
+            out << "    // " << files[i].path << "\n"
+                << "    alignas(16) constexpr unsigned char asset_" << i << "[] = {";
+            if (content.empty()) {
+                out << " 0";
+            }
+            for (std::size_t j = 0; j < content.size(); ++j) {
+                out << (j % 24 == 0 ? "\n        " : " ") << static_cast<unsigned>(static_cast<unsigned char>(content[j])) << ',';
+            }
+            out << "\n    };\n";
+        }
+        out << "\n    constexpr Asset table[] = {\n";
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            out << "        { " << cpp_literal(files[i].path) << ", asset_" << i << ", " << files[i].content.size()
+                << ", " << files[i].mtime << " },\n";
+        }
+        out << "    };\n\n    constexpr std::uint32_t displacements[] = {";
+        for (std::size_t i = 0; i < displacements.size(); ++i) {
+            out << (i % 12 == 0 ? "\n        " : " ") << displacements[i] << ',';
+        }
+        out << "\n    };\n\n    constexpr std::uint32_t slots[] = {";
+        for (std::size_t i = 0; i < slots.size(); ++i) {
+            out << (i % 12 == 0 ? "\n        " : " ") << slots[i] << ',';
+        }
+        out << "\n    };\n}\n\n"
+            << "    std::span<const Asset> assets() {\n        return table;\n    }\n\n"
+            << "    const Asset* find(std::string_view path) {\n"
+            << "        const std::uint32_t displacement = displacements[hash(path, 0) % std::size(displacements)];\n"
+            << "        const Asset& asset = table[slots[hash(path, displacement) % std::size(table)]];\n"
+            << "        return asset.path == path ? &asset : nullptr;\n"
+            << "    }\n\n}\n";
+        return out.str();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: embed_static <static_dir> <output.cpp>" << std::endl;
+        return 1;
+    }
+    const fs::path static_dir = fs::absolute(argv[1]);
+    const fs::path output = argv[2];
+
+    std::vector<SourceFile> files;
+    std::error_code ec;
+    if (fs::is_directory(static_dir, ec)) {
+        for (const auto& entry : fs::recursive_directory_iterator(static_dir)) {
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            SourceFile file;
+            file.path = entry.path().lexically_relative(static_dir).generic_string();
+            file.mtime = to_unix_seconds(entry.last_write_time());
+            if (!read_file(entry.path(), file.content)) {
+                std::cerr << "embed_static: cannot read " << entry.path() << std::endl;
+                return 1;
+            }
+            files.push_back(std::move(file));
+        }
+    }
+    else {
+        std::cerr << "embed_static: warning: " << static_dir << " is not a directory, embedding nothing" << std::endl;
+    }
+    // Порядок обхода каталога не определён — сортируем, чтобы вывод был воспроизводимым
+    std::sort(files.begin(), files.end(), [](const SourceFile& lhs, const SourceFile& rhs) {
+        return lhs.path < rhs.path;
+    });
+
+    std::vector<std::uint32_t> displacements;
+    std::vector<std::uint32_t> slots;
+    if (!files.empty() && !build_perfect_hash(files, displacements, slots)) {
+        std::cerr << "embed_static: failed to build a perfect hash for " << files.size() << " files" << std::endl;
+        return 1;
+    }
+    const std::string generated = generate(static_dir, files, displacements, slots);
+
+    // Содержимое не изменилось — не переписываем, но обновляем время: выход custom command
+    // должен быть новее своих DEPENDS, иначе make/ninja будут запускать генератор на каждой сборке
+    std::string existing;
+    if (read_file(output, existing) && existing == generated) {
+        fs::last_write_time(output, fs::file_time_type::clock::now(), ec);
+        if (ec) {
+            std::cerr << "embed_static: cannot touch " << output << ": " << ec.message() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    fs::create_directories(output.parent_path().empty() ? fs::path(".") : output.parent_path(), ec);
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    out << generated;
+    if (!out) {
+        std::cerr << "embed_static: cannot write " << output << std::endl;
+        return 1;
+    }
+    std::cout << "embed_static: " << files.size() << " files from " << static_dir << std::endl;
+    return 0;
+}